@@ -0,0 +1,98 @@
+/* 
+ * Description: 
+ *   Compares the ring-buffer deq with the linked list it replaced
+ *   (Bench/deqlist.c), and prints rows as in stats.h, in nanoseconds
+ *   per operation; the case is the implementation, operation, and
+ *   number of elements.
+ *   Usage: Bench/deq [n]
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../deq.h"
+#include "stats.h"
+
+#define RUNS 9
+
+typedef struct {
+  char *name;
+  Deq (*new)();
+  void (*put)(Deq q, Data d);
+  Data (*get)(Deq q);
+  Data (*ith)(Deq q, int i);
+  void (*del)(Deq q, DeqMapF f);
+  Str (*str)(Deq q, DeqStrF f);
+} Impl;
+
+extern Deq list_new();
+extern void list_tail_put(Deq q, Data d);
+extern Data list_head_get(Deq q);
+extern Data list_head_ith(Deq q, int i);
+extern void list_del(Deq q, DeqMapF f);
+extern Str list_str(Deq q, DeqStrF f);
+
+static Impl impls[]={
+  {"ring",deq_new,deq_tail_put,deq_head_get,deq_head_ith,deq_del,deq_str},
+  {"list",list_new,list_tail_put,list_head_get,list_head_ith,list_del,list_str},
+};
+
+static void row(Impl *impl, char *op, int n, double *v) {
+  char what[64];
+  snprintf(what,sizeof(what),"%s %s %d",impl->name,op,n);
+  report("deq",what,v,RUNS,"ns/op");
+}
+
+static void bench(Impl *impl, int n) {
+  static char *word="word";
+  volatile Data sink;
+  double v[RUNS];
+  int m=n<20000 ? n : 20000;	// the list's ith loop is quadratic
+
+  for (int r=0; r<RUNS; r++) {
+    double t0=now();
+    Deq q=impl->new();
+    for (int i=0; i<n; i++)
+      impl->put(q,(Data)(long)(i+1));
+    for (int i=0; i<n; i++)
+      sink=impl->get(q);
+    impl->del(q,0);
+    v[r]=(now()-t0)/(2.0*n)*1e9;
+  }
+  row(impl,"put+get",n,v);
+
+  for (int r=0; r<RUNS; r++) {
+    Deq q=impl->new();
+    for (int i=0; i<n; i++)
+      impl->put(q,(Data)(long)(i+1));
+    double t0=now();
+    for (int i=0; i<m; i++)
+      sink=impl->ith(q,i);
+    v[r]=(now()-t0)/m*1e9;
+    impl->del(q,0);
+  }
+  row(impl,"ith-loop",n,v);
+
+  for (int r=0; r<RUNS; r++) {
+    Deq q=impl->new();
+    for (int i=0; i<m; i++)
+      impl->put(q,word);
+    double t0=now();
+    free(impl->str(q,0));
+    v[r]=(now()-t0)/m*1e9;
+    impl->del(q,0);
+  }
+  row(impl,"str",m,v);
+  (void)sink;
+}
+
+int main(int argc, char **argv) {
+  int n=argc>1 ? atoi(argv[1]) : 100000;
+  header();
+  for (int size=100; size<=n; size*=10)
+    for (int i=0; i<sizeof(impls)/sizeof(*impls); i++)
+      bench(impls+i,size);
+  return 0;
+}
@@ -0,0 +1,44 @@
+/* 
+ * Description: 
+ *   Times loading the history at startup, from files of 1,000 to
+ *   1,000,000 lines, with HISTFILESIZE at its default, and prints rows
+ *   as in stats.h.
+ *   Usage: Bench/history [max-lines]
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../History.h"
+#include "stats.h"
+
+#define RUNS 9
+
+int main(int argc, char **argv) {
+  int max=argc>1 ? atoi(argv[1]) : 1000000;
+  char file[]="/tmp/Bench_history.XXXXXX";
+  int fd=mkstemp(file);
+  FILE *f=fdopen(fd,"w");
+  int lines=0;
+  header();
+  for (int n=1000; n<=max; n*=10) {
+    for (; lines<n; lines++)
+      fprintf(f,"ls -l /some/directory/%d | grep pattern%d\n",lines,lines%97);
+    fflush(f);
+    double v[RUNS];
+    for (int i=0; i<RUNS; i++) {
+      double t0=now();
+      openHistory(file);
+      v[i]=(now()-t0)*1e3;
+      closeHistory();
+    }
+    char what[32];
+    sprintf(what,"%d-lines",n);
+    report("history",what,v,RUNS,"ms");
+  }
+  fclose(f);
+  unlink(file);
+  return 0;
+}
@@ -0,0 +1,58 @@
+/* 
+ * Description: 
+ *   Times parseTree() and interpretTree() on generated lines of 10 to
+ *   1,000,000 words, i.e., everything before a line's first fork, and
+ *   prints rows as in stats.h, in millions of words per second.
+ *   Usage: Bench/parse [max-words]
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Parser.h"
+#include "../Interpreter.h"
+#include "stats.h"
+
+#define RUNS 9
+
+// a pipeline of n words, with a quoted word and an operator now and then
+static char *line(int n) {
+  char *s=malloc((size_t)n*16+16);
+  size_t len=0;
+  srand(452);
+  for (int i=0; i<n; i++) {
+    if (i && i%100==0)
+      len+=sprintf(s+len,"| ");
+    if (i%37==5)
+      len+=sprintf(s+len,"'quoted %d' ",i);
+    else
+      len+=sprintf(s+len,"word%d ",rand()%100000);
+  }
+  s[len]=0;
+  return s;
+}
+
+int main(int argc, char **argv) {
+  int max=argc>1 ? atoi(argv[1]) : 1000000;
+  header();
+  for (int n=10; n<=max; n*=10) {
+    char *s=line(n);
+    int runs=n<100000 ? RUNS*10 : RUNS;
+    double v[runs];
+    for (int i=0; i<runs; i++) {
+      double t0=now();
+      Tree tree=parseTree(s);
+      Sequence sequence=interpretTree(tree);
+      freeTree(tree);
+      freeSequence(sequence);
+      v[i]=n/(now()-t0)/1e6;
+    }
+    char what[32];
+    sprintf(what,"%d-words",n);
+    report("parse",what,v,runs,"Mwords/s");
+    free(s);
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+/* 
+ * Description: 
+ *   Times the scanner on a long generated line, once per delimiter
+ *   classifier, and prints rows as in stats.h, in megabytes per second;
+ *   the case is the classifier and the line's size.
+ *   Usage: Bench/scan [megabytes [runs]]
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Scanner.h"
+#include "../Delim.h"
+#include "stats.h"
+
+#define RUNS 9
+
+static char *line(size_t size) {
+  char *s=malloc(size+1);
+  if (!s)
+    exit(1);
+  size_t n=0;
+  srand(452);
+  n+=sprintf(s,"rm -f");
+  while (n<size-64) {		// paths of 8 to 63 bytes, an operator now and then
+    s[n++]=' ';
+    int len=8+rand()%56;
+    for (int i=0; i<len; i++)
+      s[n++]="abcdefghijklmnopqrstuvwxyz0123456789/._-"[rand()%40];
+    if (rand()%64==0)
+      n+=sprintf(s+n," | tee");
+  }
+  s[n]=0;
+  return s;
+}
+
+int main(int argc, char **argv) {
+  int mb=argc>1 ? atoi(argv[1]) : 16;
+  int runs=argc>2 ? atoi(argv[2]) : RUNS;
+  char *impls[]={"scalar","sse2","avx2",0};
+  char *s=line((size_t)mb<<20);
+  size_t bytes=strlen(s);
+  long expect=-1;
+  double v[runs];
+
+  header();
+  for (char **impl=impls; *impl; impl++) {
+    if (delimSelect(*impl))
+      continue;			// not on this CPU
+    long tokens=0;
+    for (int i=0; i<runs; i++) {
+      double t0=now();
+      Scanner scan=newScanner(s);
+      tokens=0;
+      while (currScanner(scan)!=ScanEnd) {
+	tokens++;
+	nextScanner(scan);
+      }
+      freeScanner(scan);
+      v[i]=bytes/(now()-t0)/1e6;
+    }
+    if (expect==-1)
+      expect=tokens;
+    else if (tokens!=expect)
+      fprintf(stderr,"scan: %s found %ld tokens, not %ld\n",*impl,tokens,expect);
+    char what[64];
+    snprintf(what,sizeof(what),"%s %dMB",*impl,mb);
+    report("scan",what,v,runs,"MB/s");
+  }
+  free(s);
+  return 0;
+}
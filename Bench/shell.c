@@ -0,0 +1,122 @@
+/* 
+ * Description: 
+ *   Times the shell from outside, as a user of it would:
+ *     latency: a /bin/true and a pwd, on a running shell's stdin, until
+ *       pwd's output comes back
+ *     pipeline: "cat < file | cat ... > /dev/null", 1 to 8 stages
+ *     background: "/bin/true &" lines, then "wait"
+ *   and prints rows as in stats.h.
+ *   Usage: Bench/shell [shell [n]]
+ * 
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "stats.h"
+
+#define RUNS 5
+#define MB 64			// through each pipeline
+
+static char *shell="./shell";
+
+// runs "shell -c commands", and returns the seconds it took
+static double run(char *commands) {
+  double t0=now();
+  pid_t pid=fork();
+  if (!pid) {
+    execl(shell,shell,"-c",commands,(char *)0);
+    _exit(127);
+  }
+  int status;
+  waitpid(pid,&status,0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status))
+    fprintf(stderr,"shell: %s: status %d\n",commands,status);
+  return now()-t0;
+}
+
+static void latency(int n) {
+  int in[2], out[2];
+  if (pipe(in) || pipe(out))
+    exit(1);
+  pid_t pid=fork();
+  if (!pid) {
+    dup2(in[0],STDIN_FILENO);
+    dup2(out[1],STDOUT_FILENO);
+    close(in[0]), close(in[1]), close(out[0]), close(out[1]);
+    execl(shell,shell,(char *)0);
+    _exit(127);
+  }
+  close(in[0]);
+  close(out[1]);
+  double *v=malloc(sizeof(*v)*n);
+  char buf[4096];
+  static char line[]="/bin/true\npwd\n";
+  for (int i=0; i<n; i++) {
+    double t0=now();
+    if (write(in[1],line,sizeof(line)-1)!=sizeof(line)-1)
+      exit(1);
+    for (ssize_t got; (got=read(out[0],buf,sizeof(buf)))>0; )
+      if (buf[got-1]=='\n')
+	break;
+    v[i]=(now()-t0)*1e6;
+  }
+  close(in[1]);
+  waitpid(pid,0,0);
+  report("latency","true+pwd",v,n,"us");
+  free(v);
+}
+
+static void pipeline() {
+  char file[]="/tmp/Bench_shell.XXXXXX";
+  int fd=mkstemp(file);
+  char block[1<<16];
+  memset(block,'x',sizeof(block));
+  for (int i=0; i<MB*16; i++)
+    if (write(fd,block,sizeof(block))!=sizeof(block))
+      exit(1);
+  close(fd);
+  for (int stages=1; stages<=8; stages*=2) {
+    char commands[512], what[32];
+    int n=sprintf(commands,"cat < %s",file);
+    for (int i=1; i<stages; i++)
+      n+=sprintf(commands+n," | cat");
+    sprintf(commands+n," > /dev/null");
+    double v[RUNS];
+    for (int i=0; i<RUNS; i++)
+      v[i]=MB/run(commands);
+    sprintf(what,"%d-stage",stages);
+    report("pipeline",what,v,RUNS,"MB/s");
+  }
+  unlink(file);
+}
+
+static void background(int n) {
+  size_t size=n*16+64;
+  char *commands=malloc(size);
+  int len=sprintf(commands,"jobmax 0\n");
+  for (int i=0; i<n; i++)
+    len+=sprintf(commands+len,"/bin/true &\n");
+  sprintf(commands+len,"wait\n");
+  double v[RUNS];
+  for (int i=0; i<RUNS; i++)
+    v[i]=n/run(commands);
+  report("background","true&",v,RUNS,"launches/s");
+  free(commands);
+}
+
+int main(int argc, char **argv) {
+  if (argc>1)
+    shell=argv[1];
+  int n=argc>2 ? atoi(argv[2]) : 10000;
+  header();
+  latency(n);
+  pipeline();
+  background(n/10);
+  return 0;
+}
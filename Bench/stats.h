@@ -0,0 +1,36 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Timing and percentile rows shared by the end-to-end benchmarks. Each
+// prints CSV rows of:
+//   bench,case,runs,p50,p90,p99,max,unit
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec+t.tv_nsec/1e9;
+}
+
+static int cmp(const void *a, const void *b) {
+  double x=*(double *)a, y=*(double *)b;
+  return x<y ? -1 : x>y;
+}
+
+static void header() {
+  printf("bench,case,runs,p50,p90,p99,max,unit\n");
+  fflush(stdout);
+}
+
+// sorts the n samples, and prints their percentiles
+static void report(char *bench, char *what, double *v, int n, char *unit) {
+  qsort(v,n,sizeof(*v),cmp);
+  printf("%s,%s,%d,%.3f,%.3f,%.3f,%.3f,%s\n",bench,what,n,
+	 v[n/2],v[n*9/10],v[n*99/100],v[n-1],unit);
+  fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * Description:
+ *   Cache remembers the Sequence interpreted from each recent command
+ *   line, keyed by the line's text, so that a line sent again, e.g., by
+ *   a polling loop, is run without scanning, parsing, or building argv.
+ *   Lines are found by FNV-1a hash, in a chained table, and compared in
+ *   full. They are kept in least-recently-used order, and the oldest is
+ *   dropped past the limit: SHELL_PCACHE lines, or the pcache builtin's.
+ *
+ *   A Sequence is not changed by running it, and the cache holds its
+ *   own reference, so one may be dropped while it is still running.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Cache.h"
+#include "Stats.h"
+#include "error.h"
+
+#define MAX 128			// lines, without SHELL_PCACHE
+
+typedef struct Entry *Entry;
+
+struct Entry {
+  char *line;
+  unsigned hash;
+  Sequence sequence;
+  Entry chain;			// the next in its bucket
+  Entry newer, older;		// in use order
+};
+
+static Entry *table=0;		// buckets, size is a power of two
+static int size=0;
+static int used=0;
+static Entry newest=0, oldest=0;
+static int max=-1;		// -1 until SHELL_PCACHE is read
+static long hits=0, misses=0;
+
+static unsigned hash(char *s) {
+  unsigned h=2166136261u;	// FNV-1a
+  for (; *s; s++)
+    h=(h^(unsigned char)*s)*16777619u;
+  return h;
+}
+
+static void limit() {
+  if (max>=0)
+    return;
+  char *s=getenv("SHELL_PCACHE");
+  max=s ? atoi(s) : MAX;
+  if (max<0)
+    max=0;
+}
+
+static void detach(Entry e) {
+  if (e->newer)
+    e->newer->older=e->older;
+  else
+    newest=e->older;
+  if (e->older)
+    e->older->newer=e->newer;
+  else
+    oldest=e->newer;
+}
+
+static void push(Entry e) {
+  e->newer=0;
+  e->older=newest;
+  if (newest)
+    newest->newer=e;
+  newest=e;
+  if (!oldest)
+    oldest=e;
+}
+
+static void drop(Entry e) {
+  Entry *p=table+(e->hash&(size-1));
+  while (*p!=e)
+    p=&(*p)->chain;
+  *p=e->chain;
+  detach(e);
+  used--;
+  freeSequence(e->sequence);
+  free(e->line);
+  free(e);
+}
+
+static void grow() {
+  Entry *old=table;
+  int n=size;
+  size=size ? 2*size : 64;
+  if (!(table=calloc(size,sizeof(*table))))
+    ERROR("calloc() failed");
+  for (int i=0; i<n; i++)
+    for (Entry e=old[i], next; e; e=next) {
+      next=e->chain;
+      e->chain=table[e->hash&(size-1)];
+      table[e->hash&(size-1)]=e;
+    }
+  free(old);
+}
+
+/**
+ * Returns the Sequence for a line, held for the caller to free, or 0 if
+ * the line is not cached.
+ */
+extern Sequence lookupCache(char *line) {
+  limit();
+  if (!max)
+    return 0;
+  unsigned h=hash(line);
+  for (Entry e=size ? table[h&(size-1)] : 0; e; e=e->chain)
+    if (e->hash==h && !strcmp(e->line,line)) {
+      hits++;
+      STAT(pcachehits,1);
+      detach(e);
+      push(e);
+      return holdSequence(e->sequence);
+    }
+  misses++;
+  STAT(pcachemisses,1);
+  return 0;
+}
+
+/**
+ * Remembers the Sequence for a line, which was not found, holding a
+ * reference of its own.
+ */
+extern void addCache(char *line, Sequence sequence) {
+  limit();
+  if (!max)
+    return;
+  while (used>=max)
+    drop(oldest);
+  if (2*(used+1)>size)
+    grow();
+  Entry e=(Entry)malloc(sizeof(*e));
+  if (!e || !(e->line=strdup(line)))
+    ERROR("malloc() failed");
+  e->hash=hash(line);
+  e->sequence=holdSequence(sequence);
+  e->chain=table[e->hash&(size-1)];
+  table[e->hash&(size-1)]=e;
+  push(e);
+  used++;
+}
+
+// keeps at most n lines; 0 turns the cache off
+extern void limitCache(int n) {
+  max=n<0 ? 0 : n;
+  while (used>max)
+    drop(oldest);
+}
+
+extern void clearCache() {
+  while (oldest)
+    drop(oldest);
+  hits=misses=0;
+}
+
+extern void printCache() {
+  limit();
+  printf("pcache %d/%d lines, %ld hits, %ld misses\n",used,max,hits,misses);
+}
+
+extern void freeCache() {
+  while (oldest)
+    drop(oldest);
+  free(table);
+  table=0;
+  size=0;
+}
@@ -0,0 +1,17 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+// Interpreted command lines, by their text, so that a repeated line is
+// not scanned, parsed, or interpreted again. The least recently used
+// line is dropped when the cache is full (SHELL_PCACHE lines).
+
+#include "Sequence.h"
+
+extern Sequence lookupCache(char *line); // held, or 0
+extern void addCache(char *line, Sequence sequence);
+extern void limitCache(int max);
+extern void clearCache();
+extern void printCache();
+extern void freeCache();
+
+#endif
@@ -11,29 +11,52 @@
  * 
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 
 #include <string.h>
 #include "Command.h"
+#include "Hash.h"
+#include "Cache.h"
+#include "History.h"
+#include "Scanner.h"
+#include "Vars.h"
+#include "Trace.h"
+#include "Stats.h"
+#include "Utility.h"
 #include "error.h"
-#include <readline/history.h>
 
 typedef struct {
   char *file;
   char **argv;
+  char *in;			// < file, or 0
+  char *out;			// > file, or 0
+  char **raw;			// the words' text, if one has a $, or 0
 } *CommandRep;
 
 #define BIARGS CommandRep r, int *eof, Jobs jobs // CommandRep, End of File Pointer, Jobs
 #define BINAME(name) bi_##name
 #define BIDEFN(name) static void BINAME(name) (BIARGS)
-#define BIENTRY(name) {#name,BINAME(name)}
+// a perfect hash of a builtin's name, by its first and last bytes
+#define BITABLE 64
+#define BIHASH(first,last) (((first)+17*(last))&(BITABLE-1))
+#define BISLOT(s,name,first,last) [BIHASH(first,last)]={s,BINAME(name)}
+#define BIENTRY(name,first,last) BISLOT(#name,name,first,last)
+
+extern char **environ;
 
 static char *owd=0; // Old directory
 static char *cwd=0; // Current directory
+static int status=0; // of the last builtin, which it sets if not 0
 
 static void builtin_args(CommandRep r, int n) {
   // printf("builtin args\n");
@@ -43,29 +66,30 @@ static void builtin_args(CommandRep r, int n) {
     ERROR("wrong number of arguments to builtin command"); // warn
 }
 
-/* History Builtin */
+/**
+ * history -> lists the history
+ * history N -> lists its last N entries
+ * history -s PATTERN -> lists the entries that contain PATTERN
+ * history -c -> clears it
+ */
 BIDEFN(history){
-  if(r->argv[1]){
+  char **argv=r->argv+1;
+  if (!*argv) {
+    printHistory(0);
+    return;
+  }
+  if (!strcmp(*argv,"-c")) { // Clears history
     builtin_args(r,1);
-
-    if (strcmp(r->argv[1],"-c")==0) { // Clears history
-      stifle_history(0);
-      unstifle_history();
-      history_base = 1;
-    }
-
-  } else {
-    builtin_args(r,0);
+    clearHistory();
+    return;
   }
-
-  register HIST_ENTRY **hist;
-  hist = history_list ();
-  int i;
-  if (hist){
-    for (i = 0; hist[i]; i++){
-      printf ("%d: %s\n", i + history_base, hist[i]->line);
-    }
+  if (!strcmp(*argv,"-s")) {
+    builtin_args(r,2);
+    searchHistory(argv[1]);
+    return;
   }
+  builtin_args(r,1);
+  printHistory(atoi(*argv));
 }
 
 /* Exits shell builtin */
@@ -106,132 +130,932 @@ BIDEFN(cd) {
     ERROR("chdir() failed"); // warn
 }
 
-/*
- * BuiltIn Struct:
- *  *s -> not originally set
- *  *f -> points to a list of arguments (r, eof, jobs) is what was passed in
- *  r -> CommandRep
+typedef void (*BuiltinF)(BIARGS);
+
+/**
+ * hash -> lists remembered command locations
+ * hash -r -> forgets them all
+ * hash -p path name -> remembers name as path
+ * hash name... -> looks each name up, and remembers it
  */
-static int builtin(BIARGS) {
-  // printf("BuiltIn called\n");
+BIDEFN(hash) {
+  char **argv=r->argv+1;
+  if (!*argv) {
+    printHash();
+    return;
+  }
+  if (!strcmp(*argv,"-r")) {
+    builtin_args(r,1);
+    clearHash();
+    return;
+  }
+  if (!strcmp(*argv,"-p")) {
+    builtin_args(r,3);
+    addHash(argv[2],argv[1]);
+    return;
+  }
+  for (; *argv; argv++)
+    if (!lookupHash(*argv)) {
+      WARN("%s: not found",*argv);
+      status=1;
+    }
+}
+
+/**
+ * jobs -> lists the jobs
+ * jobs -l -> lists the jobs, and the state of each of their processes
+ */
+BIDEFN(jobs) {
+  if (r->argv[1] && !strcmp(r->argv[1],"-l")) {
+    builtin_args(r,1);
+    printJobs(jobs,1);
+    return;
+  }
+  builtin_args(r,0);
+  printJobs(jobs,0);
+}
+
+// a job spec, or the newest job; warns and returns 0 if there is none
+static int jobarg(CommandRep r, Jobs jobs) {
+  char *spec=r->argv[1] ? r->argv[1] : "%";
+  if (r->argv[1])
+    builtin_args(r,1);
+  int job=findJobs(jobs,spec);
+  if (!job) {
+    WARN("%s: %s: no such job",r->file,spec);
+    status=1;
+  }
+  return job;
+}
+
+/**
+ * wait -> waits for every background job
+ * wait -n -> waits for the next background job to finish
+ * wait %job|pid... -> waits for each
+ */
+BIDEFN(wait) {
+  char **argv=r->argv+1;
+  if (!*argv) {
+    waitallJobs(jobs);
+    return;
+  }
+  if (!strcmp(*argv,"-n")) {
+    builtin_args(r,1);
+    status=waitanyJobs(jobs);
+    return;
+  }
+  for (; *argv; argv++) {
+    int job=findJobs(jobs,*argv);
+    if (job)
+      status=waitJobs(jobs,job);
+    else {
+      WARN("wait: %s: no such job",*argv);
+      status=127;
+    }
+  }
+}
+
+/**
+ * jobmax -> shows the limits on running background jobs
+ * jobmax N -> runs at most N background jobs at once; 0 is no limit
+ * jobmax -l LOAD -> only starts one while the load average is below LOAD
+ */
+BIDEFN(jobmax) {
+  char **argv=r->argv+1;
+  if (!*argv) {
+    double load;
+    int max=maxJobs(jobs,&load);
+    printf("jobmax %d\n",max);
+    if (load>0)
+      printf("jobmax -l %.2f\n",load);
+    return;
+  }
+  if (!strcmp(*argv,"-l")) {
+    builtin_args(r,2);
+    limitJobs(jobs,-1,atof(argv[1]));
+    return;
+  }
+  builtin_args(r,1);
+  limitJobs(jobs,atoi(*argv),-1);
+}
+
+/**
+ * pcache -> shows the parse cache's size, hits and misses
+ * pcache N -> keeps at most N lines; 0 turns it off
+ * pcache -c -> empties it, and zeroes the counts
+ */
+BIDEFN(pcache) {
+  char **argv=r->argv+1;
+  if (!*argv) {
+    printCache();
+    return;
+  }
+  builtin_args(r,1);
+  if (!strcmp(*argv,"-c"))
+    clearCache();
+  else
+    limitCache(atoi(*argv));
+}
+
+BIDEFN(true) {}
+
+BIDEFN(false) {
+  status=1;
+}
+
+BIDEFN(echo) {
+  status=echoUtility(r->argv);
+}
+
+BIDEFN(printf) {
+  status=printfUtility(r->argv);
+}
+
+BIDEFN(test) {
+  status=testUtility(r->argv);
+}
+
+BIDEFN(cat) {
+  status=catUtility(r->argv);
+}
+
+/* Shows the shell's counters, as Tools/shstat does */
+BIDEFN(stats) {
+  builtin_args(r,0);
+  printStats(stdout,stats);
+}
+
+/* Continues a job in the foreground */
+BIDEFN(fg) {
+  int job=jobarg(r,jobs);
+  if (job)
+    status=fgJobs(jobs,job,1);
+}
+
+/* Continues a job in the background */
+BIDEFN(bg) {
+  int job=jobarg(r,jobs);
+  if (job)
+    status=bgJobs(jobs,job);
+}
+
+static pid_t start(CommandRep r, Pipeline pipeline, Jobs jobs, int in,
+		   int out, pid_t *pgid, int tty);
+
+#define ARGSLACK 2048		// as POSIX xargs leaves
+
+// bytes left for items' argv, after the environment and the command
+static long argroom(char **cmd, int n) {
+  long room=sysconf(_SC_ARG_MAX)-ARGSLACK;
+  for (char **e=environ; *e; e++)
+    room-=strlen(*e)+1+sizeof(*e);
+  for (int i=0; i<n; i++)
+    room-=strlen(cmd[i])+1+sizeof(*cmd);
+  return room-sizeof(*cmd);	// argv's terminator
+}
+
+// reads all of stdin, splits it into its non-empty lines
+static char **readitems(char **buf, int *n) {
+  size_t len=0, size=1<<16;
+  char *s=malloc(size);
+  if (!s)
+    ERROR("malloc() failed");
+  for (;;) {
+    if (len==size && !(s=realloc(s,size*=2)))
+      ERROR("realloc() failed");
+    ssize_t got=read(STDIN_FILENO,s+len,size-len);
+    if (got==-1 && errno==EINTR)
+      continue;
+    if (got<=0)
+      break;
+    len+=got;
+  }
+  if (len==size && !(s=realloc(s,size+1)))
+    ERROR("realloc() failed");
+  int max=16;
+  char **items=malloc(sizeof(*items)*max);
+  if (!items)
+    ERROR("malloc() failed");
+  *n=0;
+  for (char *p=s, *end=s+len; p<=end; p++) {
+    char *nl=memchr(p,'\n',end-p);
+    if (!nl)
+      nl=end;
+    *nl=0;
+    if (nl>p) {
+      if (*n==max && !(items=realloc(items,sizeof(*items)*(max*=2))))
+	ERROR("realloc() failed");
+      items[(*n)++]=p;
+    }
+    p=nl;
+  }
+  *buf=s;
+  return items;
+}
+
+// writes out, and closes, a run's held output
+static void emit(int fd) {
+  char buf[1<<16];
+  ssize_t n;
+  lseek(fd,0,SEEK_SET);
+  while ((n=read(fd,buf,sizeof(buf)))>0)
+    if (write(STDOUT_FILENO,buf,n)!=n)
+      break;
+  close(fd);
+}
+
+/**
+ * pmap [-P procs] [-n items] [-k] command [arg...] [::: item...]
+ *
+ * Runs command with items appended to its arguments, as xargs does,
+ * with as many items in each run as the kernel's argument limit allows
+ * (at most -n), and up to -P runs at once (by default, one per online
+ * CPU). The items are the words after :::, or else the lines of stdin.
+ * Runs write to stdout as they go; with -k, each run's output is held
+ * in a memfd, and written in the order of the items. A run killed by
+ * SIGINT stops the rest from starting. As with xargs, the status is 123
+ * if any run failed, or could not be started.
+ */
+BIDEFN(pmap) {
+  int procs=sysconf(_SC_NPROCESSORS_ONLN), max=0, keep=0;
+  char **argv=r->argv+1;
+  for (; *argv && **argv=='-'; argv++)
+    if (!strcmp(*argv,"-k"))
+      keep=1;
+    else if (!strcmp(*argv,"-P") && argv[1])
+      procs=atoi(*++argv);
+    else if (!strcmp(*argv,"-n") && argv[1])
+      max=atoi(*++argv);
+    else
+      break;
+  int ncmd=0;
+  while (argv[ncmd] && strcmp(argv[ncmd],":::"))
+    ncmd++;
+  if (!ncmd || procs<1 || max<0) {
+    WARN("usage: pmap [-P procs] [-n items] [-k] command [arg...] "
+	 "[::: item...]");
+    status=1;
+    return;
+  }
+  long room=argroom(argv,ncmd);
+  if (room<=0) {
+    WARN("pmap: no room for arguments");
+    status=1;
+    return;
+  }
+
+  char *buf=0, **items;
+  int n=0;
+  if (argv[ncmd]) {
+    items=argv+ncmd+1;
+    while (items[n])
+      n++;
+  } else
+    items=readitems(&buf,&n);
+
+  // batch b is items[first[b]] up to items[first[b+1]]
+  int *first=malloc(sizeof(*first)*(n+1));
+  if (!first)
+    ERROR("malloc() failed");
+  int batches=0;
+  for (int i=0; i<n; ) {
+    first[batches++]=i;
+    long used=0;
+    for (int k=0; i<n && (!max || k<max); i++, k++) {
+      long cost=strlen(items[i])+1+sizeof(*items);
+      if (k && used+cost>room)
+	break;
+      used+=cost;
+    }
+  }
+  first[batches]=n;
+
+  int *ids=malloc(sizeof(*ids)*procs);	// running jobs
+  int *which=malloc(sizeof(*which)*procs); // and their batches
+  int *held=malloc(sizeof(*held)*batches); // -k output, or -1
+  char *done=calloc(batches+1,1);
+  char **args=malloc(sizeof(*args)*(ncmd+n+1));
+  if (!ids || !which || !held || !done || !args)
+    ERROR("malloc() failed");
+  memcpy(args,argv,sizeof(*args)*ncmd);
+  int null=open("/dev/null",O_RDONLY|O_CLOEXEC);
+  if (null==-1)
+    ERROR("open() failed");
+  pid_t pgid=0;
+  pid_t *group=ttyJobs(jobs)>=0 ? &pgid : 0;
+  sigset_t set, old;
+  sigemptyset(&set);
+  sigaddset(&set,SIGCHLD);
+
+  fflush(stdout);
+  status=0;
+  int next=0, running=0, shown=0;
+  while (next<batches || running) {
+    for (; next<batches && running<procs; next++) {
+      int size=first[next+1]-first[next];
+      memcpy(args+ncmd,items+first[next],sizeof(*args)*size);
+      args[ncmd+size]=0;
+      typeof(*r) run={args[0],args,0,0,0};
+      int out=STDOUT_FILENO;
+      held[next]=-1;
+      if (keep && (out=held[next]=memfd_create("pmap",MFD_CLOEXEC))==-1)
+	ERROR("memfd_create() failed");
+      // a group may be joined only while an unreaped process is in it
+      sigprocmask(SIG_BLOCK,&set,&old);
+      if (group && !liveJobs(jobs,ids,running))
+	pgid=0;
+      pid_t pid=start(&run,0,jobs,null,out,group,
+		      group && !pgid ? ttyJobs(jobs) : -1);
+      if (pid>0) {
+	ids[running]=addJobs(jobs,0,&pid,1,group ? pgid : 0);
+	which[running++]=next;
+      } else {
+	done[next]=1;
+	status=123;
+      }
+      sigprocmask(SIG_SETMASK,&old,0);
+    }
+    if (running) {
+      int code;
+      int i=waitfirstJobs(jobs,ids,running,&code);
+      done[which[i]]=1;
+      if (code==128+SIGINT)	// ^C: start no more
+	batches=next;
+      if (code)
+	status=123;
+      ids[i]=ids[--running];
+      which[i]=which[running];
+    }
+    for (; done[shown]; shown++)	// in order, as far as they are done
+      if (held[shown]!=-1)
+	emit(held[shown]);
+  }
+  if (group)
+    tcsetpgrp(ttyJobs(jobs),getpgrp());
+  close(null);
+  free(args);
+  free(done);
+  free(held);
+  free(which);
+  free(ids);
+  free(first);
+  if (buf) {
+    free(items);
+    free(buf);
+  }
+}
+
+static void replace(CommandRep r);
+
+/**
+ * exec command [arg...] -> replaces the shell with command
+ * exec -> keeps exec's own redirections, for the rest of the shell
+ */
+BIDEFN(exec) {
+  if (!r->argv[1])
+    return;			// inproc() leaves them in place
+  typeof(*r) run={r->argv[1],r->argv+1,0,0,0};
+  replace(&run);
+}
+
+/**
+ * Returns the builtin that runs a command, or 0. Builtins are found in
+ * one probe of a table laid out at compile time, and one strcmp(): no
+ * two names share their first and last bytes' hash. Adding a builtin
+ * that does fails to compile, as the table's initializers then overlap,
+ * and needs another multiplier in BIHASH. C cannot index a string
+ * literal in a constant expression, so each entry's bytes are typed by
+ * hand and checked against its name on the first lookup. cat with
+ * options it does not take is left to the real cat.
+ */
+static BuiltinF findBuiltin(CommandRep r) {
   typedef struct { // Builtin
     char *s;
-    void (*f)(BIARGS);
+    BuiltinF f;
   } Builtin;
-  // printf("BuiltIn Struct created\n");
-  static const Builtin builtins[]={
-    BIENTRY(exit),
-    BIENTRY(pwd),
-    BIENTRY(cd),
-    BIENTRY(history),
-    {0,0}
+#pragma GCC diagnostic push
+#pragma GCC diagnostic error "-Woverride-init"
+  static const Builtin builtins[BITABLE]={
+    BIENTRY(exit,'e','t'),
+    BIENTRY(pwd,'p','d'),
+    BIENTRY(cd,'c','d'),
+    BIENTRY(history,'h','y'),
+    BIENTRY(hash,'h','h'),
+    BIENTRY(jobs,'j','s'),
+    BIENTRY(wait,'w','t'),
+    BIENTRY(fg,'f','g'),
+    BIENTRY(bg,'b','g'),
+    BIENTRY(jobmax,'j','x'),
+    BIENTRY(pmap,'p','p'),
+    BIENTRY(exec,'e','c'),
+    BIENTRY(pcache,'p','e'),
+    BIENTRY(stats,'s','s'),
+    BIENTRY(true,'t','e'),
+    BIENTRY(false,'f','e'),
+    BIENTRY(echo,'e','o'),
+    BIENTRY(printf,'p','f'),
+    BIENTRY(test,'t','t'),
+    BISLOT("[",test,'[','['),
+    BIENTRY(cat,'c','t'),
   };
-  // printf("BuiltIn Array created\n");
-
-  int i;
-  for (i=0; builtins[i].s; i++){ // builtins[i].s is a pointer, loop will continue until the pointer s references to a 0 or null
-    // printf("\tFor loop iteration\n");
-    if (!strcmp(r->file,builtins[i].s)) { // The strcmp() compares two strings character by character. If the strings are equal, the function returns 0.
-      // printf("For loop is entered\n");
-      builtins[i].f(r,eof,jobs); // f is a function pointer, 
-      return 1;
+#pragma GCC diagnostic pop
+  static int checked;
+  if (!checked) {
+    for (int i=0; i<BITABLE; i++) {
+      const char *s=builtins[i].s;
+      if (s && BIHASH((unsigned char)s[0],
+		      (unsigned char)s[strlen(s)-1])!=i)
+	ERROR("builtin's hash bytes do not match its name");
     }
+    checked=1;
   }
-  return 0;
+
+  char *file=r->file;
+  size_t len=strlen(file);
+  if (!len)
+    return 0;
+  const Builtin *b=builtins+BIHASH((unsigned char)file[0],
+				   (unsigned char)file[len-1]);
+  if (!b->s || strcmp(file,b->s))
+    return 0;
+  if (b->f==BINAME(cat) && !catownsUtility(r->argv))
+    return 0;
+  return b->f;
+}
+
+/**
+ * Returns the exit status of the last builtin run in the shell itself,
+ * or 1 if its redirection failed.
+ */
+extern int statusCommand() {
+  return status;
+}
+
+static int builtin(BIARGS) {
+  BuiltinF f=findBuiltin(r);
+  if (!f)
+    return 0;
+  STAT(builtins,1);
+  status=0;
+  f(r,eof,jobs); // f is a function pointer
+  return 1;
+}
+
+/**
+ * Builds argv, and the redirections' file names, in one allocation: the
+ * pointers, then the words' unquoted text, taken straight from the
+ * tree's slices of the line. Unquoting never lengthens a word, so its
+ * slice's length, plus a terminator, is enough for each. Freeing argv
+ * frees them all.
+ */
+static void getargs(CommandRep r, T_words words, T_redir redir) {
+  int n=words->n;
+  T_word in=redir ? redir->in : 0;
+  T_word out=redir ? redir->out : 0;
+  size_t bytes=(in ? in->len+1 : 0)+(out ? out->len+1 : 0);
+  for (int i=0; i<n; i++)
+    bytes+=words->word[i].len+1;
+  r->argv=(char **)malloc(sizeof(char *)*(n+1)+bytes);
+  if (!r->argv)
+    ERROR("malloc() failed");
+  char *d=(char *)(r->argv+n+1);
+  for (int i=0; i<n; i++) {
+    r->argv[i]=d;
+    d=unquoteScanner(d,words->word[i].s,words->word[i].len);
+  }
+  r->argv[n]=0;
+  r->in=in ? d : 0;
+  if (in)
+    d=unquoteScanner(d,in->s,in->len);
+  r->out=out ? d : 0;
+  if (out)
+    unquoteScanner(d,out->s,out->len);
+}
+
+/**
+ * Keeps the words' text, quoting and all, if one of them has a $ to
+ * expand, since its value may change from one run to the next. It is
+ * one allocation: the n words, then the in and out names, or 0s.
+ */
+static char **getraw(T_words words, T_redir redir) {
+  int n=words->n;
+  T_word word[n+2];
+  size_t bytes=0;
+  int dollar=0;
+  for (int i=0; i<n+2; i++) {
+    word[i]=i<n ? words->word+i : !redir ? 0 : i==n ? redir->in : redir->out;
+    if (word[i]) {
+      bytes+=word[i]->len+1;
+      dollar|=dollarScanner(word[i]->s,word[i]->len);
+    }
+  }
+  if (!dollar)
+    return 0;
+  char **raw=(char **)malloc(sizeof(char *)*(n+2)+bytes);
+  if (!raw)
+    ERROR("malloc() failed");
+  char *d=(char *)(raw+n+2);
+  for (int i=0; i<n+2; i++) {
+    raw[i]=word[i] ? d : 0;
+    if (word[i]) {
+      memcpy(d,word[i]->s,word[i]->len);
+      d+=word[i]->len;
+      *d++=0;
+    }
+  }
+  return raw;
 }
 
-static char **getargs(T_words words) {
-  // printf("Get args called\n");
+/**
+ * Returns a copy of a command with its $s expanded, to run now, built as
+ * getargs() builds argv. The command itself is left as it is, for the
+ * parse cache. A command with no $s is copied as it is.
+ */
+static CommandRep expand(CommandRep r) {
   int n=0;
-  T_words p=words;
-  while (p) {
-    p=p->words;
+  while (r->argv[n])
     n++;
+  char *word[n+2];
+  size_t bytes=0;
+  for (int i=0; i<n+2; i++) {
+    char *s=r->raw ? r->raw[i] : i<n ? r->argv[i] : i==n ? r->in : r->out;
+    word[i]=!s ? 0 : r->raw ? expandScanner(s,strlen(s),lookupVars) : strdup(s);
+    if (s && !word[i])
+      ERROR("malloc() failed");
+    if (word[i])
+      bytes+=strlen(word[i])+1;
   }
-  char **argv=(char **)malloc(sizeof(char *)*(n+1));
-  if (!argv)
+  CommandRep x=(CommandRep)malloc(sizeof(*x));
+  if (!x || !(x->argv=(char **)malloc(sizeof(char *)*(n+1)+bytes)))
     ERROR("malloc() failed");
-  p=words;
-  int i=0;
-  while (p) {
-    argv[i++]=strdup(p->word->s);
-    p=p->words;
+  char *d=(char *)(x->argv+n+1);
+  for (int i=0; i<n+2; i++) {
+    char *s=word[i] ? d : 0;
+    if (word[i]) {
+      d=stpcpy(d,word[i])+1;
+      free(word[i]);
+    }
+    if (i<n)
+      x->argv[i]=s;
+    else if (i==n)
+      x->in=s;
+    else
+      x->out=s;
   }
-  argv[i]=0;
-  return argv;
+  x->argv[n]=0;
+  x->file=x->argv[0];
+  x->raw=0;
+  return x;
+}
+
+/**
+ * Returns a copy of a command, with its $s expanded now, for a pipeline
+ * that may be started later.
+ */
+extern Command expandCommand(Command command) {
+  return expand(command);
 }
 
-extern Command newCommand(T_words words) {
+extern Command newCommand(T_words words, T_redir redir) {
   CommandRep r=(CommandRep)malloc(sizeof(*r));
   if (!r)
     ERROR("malloc() failed");
-  r->argv=getargs(words); // sets r->args
+  getargs(r,words,redir); // sets r->argv, r->in and r->out
   r->file=r->argv[0]; // sets r->file to the first argv[0]
+  r->raw=getraw(words,redir);
   return r;
 }
 
-static void child(CommandRep r, int fg) {
+/**
+ * Returns the command as text, for job listings. The caller frees it.
+ */
+extern char *strCommand(Command command) {
+  CommandRep r=command;
+  size_t len=0;
+  char *s;
+  FILE *f=open_memstream(&s,&len);
+  if (!f)
+    ERROR("open_memstream() failed");
+  for (char **argv=r->argv; *argv; argv++)
+    fprintf(f,"%s%s",argv==r->argv ? "" : " ",*argv);
+  if (r->in)
+    fprintf(f," < %s",r->in);
+  if (r->out)
+    fprintf(f," > %s",r->out);
+  fclose(f);
+  return s;
+}
+
+#define OUTFLAGS (O_WRONLY|O_CREAT|O_TRUNC)
+#define OUTMODE 0666
+
+/**
+ * Opens the command's redirection files onto stdin/stdout. A
+ * redirection overrides a pipe end that was already dup2()ed there.
+ * Returns 0 on success.
+ */
+static int redirect(CommandRep r) {
+  if (r->in) {
+    int fd=open(r->in,O_RDONLY);
+    if (fd==-1) {
+      WARN("%s: %s",r->in,strerror(errno));
+      return -1;
+    }
+    dup2(fd,STDIN_FILENO);
+    close(fd);
+  }
+  if (r->out) {
+    int fd=open(r->out,OUTFLAGS,OUTMODE);
+    if (fd==-1) {
+      WARN("%s: %s",r->out,strerror(errno));
+      return -1;
+    }
+    dup2(fd,STDOUT_FILENO);
+    close(fd);
+  }
+  return 0;
+}
+
+/**
+ * Runs a builtin in the shell itself. Its redirections are applied to
+ * the shell's own stdin/stdout, which are saved beforehand and put back
+ * afterward, so "pwd > file" needs no fork. Those of a bare "exec"
+ * are kept.
+ */
+static void inproc(CommandRep r, int *eof, Jobs jobs) {
+  int saved[2]={-1,-1};
+  int keep=!strcmp(r->file,"exec") && !r->argv[1];
+  fflush(stdout);
+  if (r->in && !keep)
+    saved[STDIN_FILENO]=fcntl(STDIN_FILENO,F_DUPFD_CLOEXEC,10);
+  if (r->out && !keep)
+    saved[STDOUT_FILENO]=fcntl(STDOUT_FILENO,F_DUPFD_CLOEXEC,10);
+  if (!redirect(r))
+    builtin(r,eof,jobs);
+  else
+    status=1;
+  if (interruptJobs(jobs))	// ^C, e.g., in cat: so a loop stops too
+    status=128+SIGINT;
+  fflush(stdout);
+  for (int fd=0; fd<2; fd++)
+    if (saved[fd]!=-1) {
+      dup2(saved[fd],fd);
+      close(saved[fd]);
+    }
+}
+
+// the signals a job control shell ignores or catches, and its children
+// must not
+static const int jcsignals[]={SIGINT,SIGQUIT,SIGTSTP,SIGTTIN,SIGTTOU};
+
+static void defaults() {
+  for (int i=0; i<sizeof(jcsignals)/sizeof(*jcsignals); i++)
+    signal(jcsignals[i],SIG_DFL);
+}
+
+/**
+ * Runs a builtin as a pipeline stage, in a forked child. This is the
+ * only case that still needs fork(): the builtin's code must run in a
+ * copy of the shell.
+ */
+static void child(CommandRep r, Pipeline pipeline, int in, int out,
+		  pid_t *pgid, int tty) {
   int eof=0;
+  sigset_t set;
+  sigemptyset(&set);
+  sigprocmask(SIG_SETMASK,&set,0);
+
+  if (pgid) {
+    setpgid(0,*pgid);
+    if (tty>=0)
+      tcsetpgrp(tty,getpgrp());
+    defaults();
+  }
   Jobs jobs=newJobs();
 
-  if (builtin(r,&eof,jobs))
-    return;
-  execvp(r->argv[0],r->argv);
-  ERROR("execvp() failed");
-  exit(0);
+  if (in!=STDIN_FILENO && dup2(in,STDIN_FILENO)==-1)
+    ERROR("dup2() failed");
+  if (out!=STDOUT_FILENO && dup2(out,STDOUT_FILENO)==-1)
+    ERROR("dup2() failed");
+  if (pipeline)
+    closePipeline(pipeline);
+
+  if (redirect(r))
+    exit(1);
+  builtin(r,&eof,jobs);
+  fflush(stdout);
+  exit(status);
 }
 
 /**
- * @param command -> command being executed
- * @param pipeline -> pipeline object
- * @param jobs -> queue of jobs to be executed
- * @param jobbed -> integer pointer
- * @param eof -> end of file pointer (1 = exit)
- * @param fg -> set to 1 to run in foreground
+ * Launches an external command with posix_spawn(), which glibc
+ * implements with clone(CLONE_VM|CLONE_VFORK): the shell's page tables
+ * are not copied, no matter how large the shell has grown. The program
+ * is found through the Hash table, not by a PATH search in the child.
+ * The stage's pipe ends and redirections are wired with file actions;
+ * every other pipe end is O_CLOEXEC and disappears at the exec.
  */
-extern void execCommand(Command command, Pipeline pipeline, Jobs jobs,
-			int *jobbed, int *eof, int fg) {
+static pid_t spawn(CommandRep r, int in, int out, pid_t *pgid, int tty) {
+  int rin=-1, rout=-1;		// redirections, opened here for honest errors
+  if (r->in && (in=rin=open(r->in,O_RDONLY|O_CLOEXEC))==-1) {
+    WARN("%s: %s",r->in,strerror(errno));
+    return -1;
+  }
+  if (r->out && (out=rout=open(r->out,OUTFLAGS|O_CLOEXEC,OUTMODE))==-1) {
+    WARN("%s: %s",r->out,strerror(errno));
+    if (rin!=-1)
+      close(rin);
+    return -1;
+  }
 
-  int fd[2]; // File descriptors, TODO
+  posix_spawn_file_actions_t fa;
+  if (posix_spawn_file_actions_init(&fa))
+    ERROR("posix_spawn_file_actions_init() failed");
+#if __GLIBC_PREREQ(2,35)
+  if (pgid && tty>=0)		// the child takes the terminal before exec,
+    posix_spawn_file_actions_addtcsetpgrp_np(&fa,tty); // and before dup2()s
+#endif
+  if (in!=STDIN_FILENO)
+    posix_spawn_file_actions_adddup2(&fa,in,STDIN_FILENO);
+  if (out!=STDOUT_FILENO)
+    posix_spawn_file_actions_adddup2(&fa,out,STDOUT_FILENO);
 
-  CommandRep r=command;
+  posix_spawnattr_t at;
+  posix_spawnattr_init(&at);
+  sigset_t set;
+  sigemptyset(&set);		// Jobs may start one with SIGCHLD blocked
+  posix_spawnattr_setsigmask(&at,&set);
+  short flags=POSIX_SPAWN_SETSIGMASK;
+  if (pgid) {			// job control
+    for (int i=0; i<sizeof(jcsignals)/sizeof(*jcsignals); i++)
+      sigaddset(&set,jcsignals[i]);
+    posix_spawnattr_setsigdefault(&at,&set);
+    posix_spawnattr_setpgroup(&at,*pgid);
+    flags|=POSIX_SPAWN_SETPGROUP|POSIX_SPAWN_SETSIGDEF;
+  }
+  posix_spawnattr_setflags(&at,flags);
+
+  pid_t pid;
+  int err=ENOENT;
+  char *file=lookupHash(r->file);
+  TRACE(TraceBegin,"spawn",0,0);
+  if (file) {
+    err=posix_spawn(&pid,file,&fa,&at,r->argv,environ);
+    if (err==ENOENT && file!=r->file) { // stale entry: look again
+      remHash(r->file);
+      if ((file=lookupHash(r->file)))
+	err=posix_spawn(&pid,file,&fa,&at,r->argv,environ);
+    }
+  }
+  TRACE(TraceEnd,"spawn",0,0);
+  posix_spawnattr_destroy(&at);
+  posix_spawn_file_actions_destroy(&fa);
+  if (rin!=-1)
+    close(rin);
+  if (rout!=-1)
+    close(rout);
+  if (!file) {
+    WARN("%s: command not found",r->file);
+    return -1;
+  }
+  if (err) {
+    WARN("%s: %s",r->file,strerror(err));
+    return -1;
+  }
+  if (pgid && !*pgid)
+    *pgid=pid;
+  TRACE(TraceStart,r->file,pid,0);
+  return pid;
+}
+
+/**
+ * Execs an external command in place of the shell, with the signals
+ * that job control ignores back at their defaults. Returns, having
+ * warned, if it cannot.
+ */
+static void replace(CommandRep r) {
+  const int n=sizeof(jcsignals)/sizeof(*jcsignals);
+  struct sigaction sa[n];
+  char *file=lookupHash(r->file);
+  if (!file) {
+    WARN("%s: command not found",r->file);
+    return;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  for (int i=0; i<n; i++)
+    sigaction(jcsignals[i],0,sa+i);
+  defaults();
+  TRACE(TraceMark,"exec",0,0);
+  writeTrace();			// the shell's memory is about to go
+  unlinkStats();
+  execve(file,r->argv,environ);
+  if (errno==ENOENT && file!=r->file) { // stale entry: look again
+    remHash(r->file);
+    if ((file=lookupHash(r->file)))
+      execve(file,r->argv,environ);
+  }
+  WARN("%s: %s",r->file,strerror(errno));
+  STAT(execfails,1);
+  for (int i=0; i<n; i++)
+    sigaction(jcsignals[i],sa+i,0);
+}
 
-  if (fg && builtin(r,eof,jobs)){ // error is thrown inside this builtin() function
+/**
+ * Replaces the shell with an external command, as its last act, so that
+ * no child is started and waited for. Returns, having changed nothing,
+ * if the command is a builtin, is not found, or a redirection cannot be
+ * opened: it is then run as usual, which reports why.
+ */
+extern void tailCommand(Command command) {
+  CommandRep r=command;
+  if (r->raw)
+    r=expand(r);
+  int in=-1, out=-1;
+  if (findBuiltin(r) || !lookupHash(r->file) ||
+      (r->in && (in=open(r->in,O_RDONLY))==-1) ||
+      (r->out && (out=open(r->out,OUTFLAGS,OUTMODE))==-1)) {
+    if (in!=-1)
+      close(in);
+    if (r!=command)
+      freeCommand(r);
     return;
   }
-  
-  if (!*jobbed) {
-    *jobbed=1;
-    addJobs(jobs,pipeline);
+  if (in!=-1 && (dup2(in,STDIN_FILENO)==-1 || close(in)))
+    ERROR("dup2() failed");
+  if (out!=-1 && (dup2(out,STDOUT_FILENO)==-1 || close(out)))
+    ERROR("dup2() failed");
+  replace(r);
+  exit(127);			// stdin and stdout are no longer the shell's
+}
+
+// starts a child for the command: spawned, or forked for a builtin
+static pid_t start(CommandRep r, Pipeline pipeline, Jobs jobs, int in,
+		   int out, pid_t *pgid, int tty) {
+  if (!findBuiltin(r)) {
+    pid_t pid=spawn(r,in,out,pgid,tty);
+    if (pid>0)
+      STAT(spawns,1);
+    else
+      STAT(execfails,1);
+    return pid;
   }
 
+  TRACE(TraceBegin,"fork",0,0);
   int pid=fork();
   if (pid==-1){
     ERROR("fork() failed");
   }
-  if (pid==0){ // Returned a successful child process
-    // close(fd[0]);
-    // write(fd[1], __, ___)
-    int rc_wait;
-    if(fg == 1){
-      rc_wait = waitpid(pid, NULL, 0);
-    }
-    child(r,fg);
-  } else { // Returned to parent/caller
-    // close(fd[1]);
-    // read string from pipe and store it TODO
-    if(fg == 1){
-      waitpid(pid, NULL, 0);
-    }
+  if (pid==0) // Returned a successful child process
+    child(r,pipeline,in,out,pgid,tty);
+  TRACE(TraceEnd,"fork",0,0);
+  TRACE(TraceStart,r->file,pid,0);
+  STAT(forks,1);
+  if (pgid) {			// as the child does, to win any race
+    setpgid(pid,*pgid ? *pgid : pid);
+    if (!*pgid)
+      *pgid=pid;
+  }
+  return pid; // Returned to parent/caller, who waits for the pipeline
+}
+
+/**
+ * @param command -> command being executed
+ * @param pipeline -> pipeline object
+ * @param jobs -> queue of jobs to be executed
+ * @param eof -> end of file pointer (1 = exit)
+ * @param fg -> set to 1 to let a builtin run in the shell itself
+ * @param in -> descriptor to use as stdin
+ * @param out -> descriptor to use as stdout
+ * @param pgid -> 0 for no job control; else the process group to join,
+ *   or 0 in it to start one, which is then stored there
+ * @return pid of the child, 0 if a builtin ran in the shell, or -1 if
+ *   the command could not be started
+ */
+extern int execCommand(Command command, Pipeline pipeline, Jobs jobs,
+		       int *eof, int fg, int in, int out, pid_t *pgid) {
+  CommandRep r=command;
+  pid_t pid=0;
+  STAT(commands,1);
+  if (r->raw)
+    r=expand(r);
+
+  if (fg && findBuiltin(r)) // error is thrown inside this builtin() function
+    inproc(r,eof,jobs);
+  else {
+    // a new foreground process group takes the terminal
+    int tty=(pgid && !*pgid && fgPipeline(pipeline)) ? ttyJobs(jobs) : -1;
+    pid=start(r,pipeline,jobs,in,out,pgid,tty);
   }
+  if (r!=command)
+    freeCommand(r);
+  return pid;
 }
 
 extern void freeCommand(Command command) {
   CommandRep r=command;
-  char **argv=r->argv;
-  while (*argv)
-    free(*argv++);
-  free(r->argv);
+  free(r->argv);		// and the strings after it
+  free(r->raw);
   free(r);
 }
 
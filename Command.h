@@ -3,14 +3,19 @@
 
 typedef void *Command;
 
+#include <sys/types.h>
 #include "Tree.h"
 #include "Jobs.h"
 #include "Sequence.h"
 
-extern Command newCommand(T_words words);
+extern Command newCommand(T_words words, T_redir redir);
+extern Command expandCommand(Command command);
 
-extern void execCommand(Command command, Pipeline pipeline, Jobs jobs,
-			int *jobbed, int *eof, int fg);
+extern int execCommand(Command command, Pipeline pipeline, Jobs jobs,
+		       int *eof, int fg, int in, int out, pid_t *pgid);
+extern void tailCommand(Command command);
+extern int statusCommand();
+extern char *strCommand(Command command);
 
 extern void freeCommand(Command command);
 extern void freestateCommand();
@@ -0,0 +1,144 @@
+/*
+ * Description:
+ *   Control runs an if, while, or for. Each part is a Sequence built
+ *   once, by the Interpreter, so a loop's body is not scanned, parsed,
+ *   or interpreted again on each iteration; only its commands' $
+ *   words are expanded again. A condition is true if its last pipeline
+ *   exits 0. A loop stops when a command in it is killed by ^C, as in
+ *   bash, or the shell is to exit.
+ *
+ *   Like a pipeline, a compound command leaves $? set: to its last
+ *   command's status, or 0 if it ran none of its body.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "Control.h"
+#include "Scanner.h"
+#include "Vars.h"
+#include "error.h"
+
+typedef enum {If,While,For} Kind;
+
+typedef struct {
+  Kind kind;
+  Sequence cond;		// if, while
+  Sequence body;		// then, do
+  Sequence otherwise;		// else, or 0
+  char *name;			// for this,
+  char **words;			// in these, as written, or 0
+  int n;
+} *ControlRep;
+
+static ControlRep newControl(Kind kind, Sequence cond, Sequence body) {
+  ControlRep r=(ControlRep)malloc(sizeof(*r));
+  if (!r)
+    ERROR("malloc() failed");
+  memset(r,0,sizeof(*r));
+  r->kind=kind;
+  r->cond=cond;
+  r->body=body;
+  return r;
+}
+
+extern Control ifControl(Sequence cond, Sequence then, Sequence otherwise) {
+  ControlRep r=newControl(If,cond,then);
+  r->otherwise=otherwise;
+  return r;
+}
+
+extern Control whileControl(Sequence cond, Sequence body) {
+  return newControl(While,cond,body);
+}
+
+/**
+ * A for loop keeps its name, and its words' text, quoting and all, in
+ * one allocation, to be expanded each time the loop starts.
+ */
+extern Control forControl(T_word name, T_words words, Sequence body) {
+  ControlRep r=newControl(For,0,body);
+  int n=words ? words->n : 0;
+  size_t bytes=name->len+1;
+  for (int i=0; i<n; i++)
+    bytes+=words->word[i].len+1;
+  r->words=(char **)malloc(sizeof(char *)*n+bytes);
+  if (!r->words)
+    ERROR("malloc() failed");
+  char *d=(char *)(r->words+n);
+  for (int i=0; i<n; i++) {
+    r->words[i]=d;
+    memcpy(d,words->word[i].s,words->word[i].len);
+    d+=words->word[i].len;
+    *d++=0;
+  }
+  r->name=d;
+  memcpy(d,name->s,name->len);
+  d[name->len]=0;
+  r->n=n;
+  return r;
+}
+
+// runs a part, and returns its status
+static int run(Sequence sequence, Jobs jobs, int *eof) {
+  execSequence(sequence,jobs,eof,0);
+  return exitVars();
+}
+
+// whether to stop a loop after its last command
+static int stop(int *eof) {
+  return *eof || exitVars()==128+SIGINT;
+}
+
+static void loop(ControlRep r, Jobs jobs, int *eof) {
+  int status=0;
+  if (r->kind==While)
+    for (;;) {
+      int cond=run(r->cond,jobs,eof);
+      if (stop(eof))
+	status=cond;
+      if (cond || stop(eof))
+	break;
+      status=run(r->body,jobs,eof);
+      if (stop(eof))
+	break;
+    }
+  else
+    for (int i=0; i<r->n && !*eof; i++) {
+      char *value=expandScanner(r->words[i],strlen(r->words[i]),lookupVars);
+      setVars(r->name,value);
+      free(value);
+      status=run(r->body,jobs,eof);
+      if (stop(eof))
+	break;
+    }
+  statusVars(&status,1);
+}
+
+extern void execControl(Control control, Jobs jobs, int *eof) {
+  ControlRep r=(ControlRep)control;
+  int status=0;
+  if (r->kind!=If)
+    loop(r,jobs,eof);
+  else if (!run(r->cond,jobs,eof)) {
+    if (!*eof)
+      run(r->body,jobs,eof);
+  } else if (r->otherwise && !*eof)
+    run(r->otherwise,jobs,eof);
+  else
+    statusVars(&status,1);
+}
+
+extern void freeControl(Control control) {
+  ControlRep r=(ControlRep)control;
+  if (r->cond)
+    freeSequence(r->cond);
+  freeSequence(r->body);
+  if (r->otherwise)
+    freeSequence(r->otherwise);
+  free(r->words);
+  free(r);
+}
@@ -0,0 +1,19 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+typedef void *Control;
+
+#include "Tree.h"
+#include "Jobs.h"
+#include "Sequence.h"
+
+// An if, while, or for, built once from its tree, and run as often as
+// it is reached. Its parts are Sequences, which it owns.
+
+extern Control ifControl(Sequence cond, Sequence then, Sequence otherwise);
+extern Control whileControl(Sequence cond, Sequence body);
+extern Control forControl(T_word name, T_words words, Sequence body);
+extern void execControl(Control control, Jobs jobs, int *eof);
+extern void freeControl(Control control);
+
+#endif
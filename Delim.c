@@ -0,0 +1,112 @@
+/* 
+ * Description: 
+ *   Delim classifies a line 64 bytes at a time with SSE2 or AVX2
+ *   compares, so the scanner can jump over a run of word bytes, or of
+ *   whitespace, with one count-trailing-zeros instead of one table
+ *   transition per byte. The implementation is picked at runtime from
+ *   what the CPU supports; SHELL_SIMD=scalar|sse2|avx2 overrides the
+ *   choice. The scalar choice leaves delimMask at 0, and the scanner
+ *   then runs its byte-at-a-time table, which is also the fallback on
+ *   other architectures.
+ * 
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Delim.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define SPECIAL(X) X(0) X(' ') X('\t') X('\n') X('\r') X('|') X('&') \
+  X(';') X('<') X('>') X('\'') X('"') X('\\')
+
+// the aligned loads may read past the end of the string, within its page
+__attribute__((no_sanitize_address))
+static uint64_t sse2(const char *p, uint64_t *spaces) {
+  uint64_t special=0, space=0;
+  for (int i=0; i<64; i+=16) {
+    __m128i v=_mm_load_si128((const __m128i *)(p+i));
+    __m128i s=_mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8(' ')),
+		   _mm_cmpeq_epi8(v,_mm_set1_epi8('\t'))),
+      _mm_or_si128(_mm_cmpeq_epi8(v,_mm_set1_epi8('\n')),
+		   _mm_cmpeq_epi8(v,_mm_set1_epi8('\r'))));
+    __m128i m=_mm_setzero_si128();
+#define X(c) m=_mm_or_si128(m,_mm_cmpeq_epi8(v,_mm_set1_epi8(c)));
+    SPECIAL(X)
+#undef X
+    special|=(uint64_t)(uint16_t)_mm_movemask_epi8(m)<<i;
+    space|=(uint64_t)(uint16_t)_mm_movemask_epi8(s)<<i;
+  }
+  *spaces=space;
+  return special;
+}
+
+__attribute__((target("avx2"),no_sanitize_address))
+static uint64_t avx2(const char *p, uint64_t *spaces) {
+  uint64_t special=0, space=0;
+  for (int i=0; i<64; i+=32) {
+    __m256i v=_mm256_load_si256((const __m256i *)(p+i));
+    __m256i s=_mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8(' ')),
+		      _mm256_cmpeq_epi8(v,_mm256_set1_epi8('\t'))),
+      _mm256_or_si256(_mm256_cmpeq_epi8(v,_mm256_set1_epi8('\n')),
+		      _mm256_cmpeq_epi8(v,_mm256_set1_epi8('\r'))));
+    __m256i m=_mm256_setzero_si256();
+#define X(c) m=_mm256_or_si256(m,_mm256_cmpeq_epi8(v,_mm256_set1_epi8(c)));
+    SPECIAL(X)
+#undef X
+    special|=(uint64_t)(uint32_t)_mm256_movemask_epi8(m)<<i;
+    space|=(uint64_t)(uint32_t)_mm256_movemask_epi8(s)<<i;
+  }
+  *spaces=space;
+  return special;
+}
+#endif
+
+static uint64_t first(const char *p, uint64_t *spaces);
+
+DelimF delimMask=first;
+
+extern int delimSelect(char *name) {
+  if (!name || !strcmp(name,"auto")) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    delimMask=__builtin_cpu_supports("avx2") ? avx2 :
+      __builtin_cpu_supports("sse2") ? sse2 : 0;
+#else
+    delimMask=0;
+#endif
+    return 0;
+  }
+  if (!strcmp(name,"scalar")) {
+    delimMask=0;
+    return 0;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (!strcmp(name,"sse2") && __builtin_cpu_supports("sse2")) {
+    delimMask=sse2;
+    return 0;
+  }
+  if (!strcmp(name,"avx2") && __builtin_cpu_supports("avx2")) {
+    delimMask=avx2;
+    return 0;
+  }
+#endif
+  return -1;
+}
+
+// the first call picks an implementation, then forwards to it
+static uint64_t first(const char *p, uint64_t *spaces) {
+  if (delimSelect(getenv("SHELL_SIMD")))
+    delimSelect("auto");
+  if (!delimMask) {		// the scanner checks, but be safe
+    *spaces=0;
+    return ~(uint64_t)0;
+  }
+  return delimMask(p,spaces);
+}
@@ -0,0 +1,19 @@
+#ifndef DELIM_H
+#define DELIM_H
+
+#include <stdint.h>
+
+// Classifies the 64 bytes at a 64-byte-aligned address, for the
+// scanner. A set bit i in the result means byte i is not a plain word
+// byte (it is whitespace, an operator, a quote, a backslash, or NUL);
+// a set bit in *spaces means byte i is whitespace. The bytes are read
+// with aligned loads, so the page holding the end of the string is
+// never crossed.
+
+typedef uint64_t (*DelimF)(const char *p, uint64_t *spaces);
+
+extern DelimF delimMask; // 0 when the scanner should go byte by byte
+
+extern int delimSelect(char *name); // "scalar", "sse2", "avx2", or "auto"
+
+#endif
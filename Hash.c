@@ -0,0 +1,346 @@
+/* 
+ * Description: 
+ *   Hash remembers where each external command was found, so that a
+ *   command is searched for along PATH once, not on every launch. The
+ *   table is open-addressed and keyed by command name. It is only
+ *   trusted while PATH is unchanged and no PATH directory has been
+ *   modified; the directories are re-stat()ed at most once a second.
+ *   The table can be written to a file at exit and read back at
+ *   startup, so a new shell begins with a warm table. The file is the
+ *   user's own, in their cache directory; it is ignored if anyone else
+ *   could have written it, and each path read from it must still be an
+ *   executable file in the PATH directory it would be found in.
+ * 
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "Hash.h"
+#include "Stats.h"
+#include "error.h"
+
+#define RECHECK 1		// seconds between directory checks
+
+typedef struct {
+  char *name;
+  char *path;
+  int hits;
+} Entry;
+
+typedef struct {
+  char *s;
+  struct timespec mtime;
+} Dir;
+
+static Entry *table=0;		// open addressing, size is a power of two
+static int size=0;
+static int used=0;
+
+static char *path=0;		// PATH when the dirs were recorded
+static Dir *dirs=0;
+static int ndirs=0;
+static time_t checked=0;
+
+static unsigned hash(char *s) {
+  unsigned h=2166136261u;	// FNV-1a
+  for (; *s; s++)
+    h=(h^(unsigned char)*s)*16777619u;
+  return h;
+}
+
+static Entry *find(char *name) {
+  if (!size)
+    return 0;
+  for (unsigned i=hash(name)&(size-1); table[i].name; i=(i+1)&(size-1))
+    if (!strcmp(table[i].name,name))
+      return table+i;
+  return 0;
+}
+
+static void insert(Entry e) {
+  unsigned i=hash(e.name)&(size-1);
+  while (table[i].name)
+    i=(i+1)&(size-1);
+  table[i]=e;
+  used++;
+}
+
+static void grow() {
+  Entry *old=table;
+  int n=size;
+  size=size ? 2*size : 64;
+  table=calloc(size,sizeof(*table));
+  if (!table)
+    ERROR("calloc() failed");
+  used=0;
+  for (int i=0; i<n; i++)
+    if (old[i].name)
+      insert(old[i]);
+  free(old);
+}
+
+static void mtimes() {
+  for (int i=0; i<ndirs; i++) {
+    struct stat st;
+    if (stat(dirs[i].s,&st))
+      memset(&dirs[i].mtime,0,sizeof(dirs[i].mtime));
+    else
+      dirs[i].mtime=st.st_mtim;
+  }
+}
+
+static void forgetdirs() {
+  for (int i=0; i<ndirs; i++)
+    free(dirs[i].s);
+  free(dirs);
+  free(path);
+  dirs=0;
+  ndirs=0;
+  path=0;
+}
+
+// records the directories of the current PATH, and their mtimes
+static void setdirs(char *p) {
+  forgetdirs();
+  path=strdup(p);
+  for (char *s=p; ; s++) {
+    char *e=strchrnul(s,':');
+    dirs=realloc(dirs,sizeof(*dirs)*(ndirs+1));
+    if (!dirs)
+      ERROR("realloc() failed");
+    dirs[ndirs++].s=(e==s) ? strdup(".") : strndup(s,e-s); // "" means "."
+    if (!*e)
+      break;
+    s=e;
+  }
+  mtimes();
+  checked=time(0);
+}
+
+static int changed() {
+  time_t now=time(0);
+  if (now-checked<RECHECK)
+    return 0;
+  checked=now;
+  for (int i=0; i<ndirs; i++) {
+    struct stat st;
+    struct timespec t={0,0};
+    if (!stat(dirs[i].s,&st))
+      t=st.st_mtim;
+    if (t.tv_sec!=dirs[i].mtime.tv_sec || t.tv_nsec!=dirs[i].mtime.tv_nsec) {
+      mtimes();
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// drops the whole table if PATH, or one of its directories, changed
+static void validate() {
+  char *p=getenv("PATH");
+  if (!p)
+    p="/bin:/usr/bin";
+  if (!path || strcmp(p,path)) {
+    clearHash();
+    setdirs(p);
+  } else if (changed())
+    clearHash();
+}
+
+static char *search(char *name) {
+  for (int i=0; i<ndirs; i++) {
+    char *file;
+    if (asprintf(&file,"%s/%s",dirs[i].s,name)==-1)
+      ERROR("asprintf() failed");
+    struct stat st;
+    if (!stat(file,&st) && S_ISREG(st.st_mode) && !access(file,X_OK))
+      return file;
+    free(file);
+  }
+  return 0;
+}
+
+extern char *lookupHash(char *name) {
+  if (strchr(name,'/'))
+    return name;
+  validate();
+  Entry *e=find(name);
+  if (e)
+    STAT(hashhits,1);
+  else {
+    STAT(hashmisses,1);
+    char *file=search(name);
+    if (!file)
+      return 0;
+    addHash(name,file);
+    free(file);
+    e=find(name);
+  }
+  e->hits++;
+  return e->path;
+}
+
+extern void addHash(char *name, char *file) {
+  Entry *e=find(name);
+  if (e) {
+    free(e->path);
+    e->path=strdup(file);
+    return;
+  }
+  if (2*(used+1)>size)
+    grow();
+  insert((Entry){strdup(name),strdup(file),0});
+}
+
+extern void remHash(char *name) {
+  Entry *e=find(name);
+  if (!e)
+    return;
+  free(e->name);
+  free(e->path);
+  e->name=0;
+  // re-insert the rest of the probe run, so lookups still reach it
+  for (unsigned i=(e-table+1)&(size-1); table[i].name; i=(i+1)&(size-1)) {
+    Entry moved=table[i];
+    table[i].name=0;
+    used--;
+    insert(moved);
+  }
+  used--;
+}
+
+extern void clearHash() {
+  for (int i=0; i<size; i++)
+    if (table[i].name) {
+      free(table[i].name);
+      free(table[i].path);
+      table[i].name=0;
+    }
+  used=0;
+}
+
+extern void printHash() {
+  if (!used) {
+    printf("hash: hash table empty\n");
+    return;
+  }
+  printf("hits\tcommand\n");
+  for (int i=0; i<size; i++)
+    if (table[i].name)
+      printf("%4d\t%s\n",table[i].hits,table[i].path);
+}
+
+// $XDG_CACHE_HOME/shell-hash, or ~/.cache/shell-hash, or 0
+static char *cachefile() {
+  static char file[4096];
+  char *dir=getenv("XDG_CACHE_HOME");
+  int n;
+  if (dir && *dir=='/')
+    n=snprintf(file,sizeof(file),"%s/shell-hash",dir);
+  else if ((dir=getenv("HOME")) && *dir=='/')
+    n=snprintf(file,sizeof(file),"%s/.cache/shell-hash",dir);
+  else
+    return 0;
+  return n<(int)sizeof(file) ? file : 0;
+}
+
+// whether path is where search() would find name: an executable in a
+// PATH directory, so a forged entry cannot remap a command
+static int trusted(char *name, char *path) {
+  char *slash=strrchr(path,'/');
+  if (!slash || strcmp(slash+1,name))
+    return 0;
+  int len=slash-path;
+  for (int i=0; i<ndirs; i++)
+    if (strlen(dirs[i].s)==len && !strncmp(dirs[i].s,path,len)) {
+      struct stat st;
+      return !stat(path,&st) && S_ISREG(st.st_mode) && !access(path,X_OK);
+    }
+  return 0;
+}
+
+/*
+ * File format: PATH on the first line, the PATH directories' mtimes on
+ * the second, then one "name path" line per entry. The entries are only
+ * read if PATH and the mtimes still match, and the file is a regular
+ * file, owned by the user, that only they can write.
+ */
+
+extern void readHash() {
+  char *file=cachefile();
+  int fd=file ? open(file,O_RDONLY|O_NOFOLLOW|O_CLOEXEC) : -1;
+  if (fd==-1)
+    return;
+  struct stat st;
+  FILE *f=0;
+  if (fstat(fd,&st) || !S_ISREG(st.st_mode) || st.st_uid!=getuid() ||
+      (st.st_mode&(S_IWGRP|S_IWOTH)) || !(f=fdopen(fd,"r"))) {
+    close(fd);
+    return;
+  }
+  validate();
+  char *line=0;
+  size_t n=0;
+  ssize_t len=getline(&line,&n,f);
+  int ok=len>0 && !strncmp(line,path,len-1) && !path[len-1];
+  for (int i=0; ok && i<ndirs; i++) {
+    long long sec;
+    long nsec;
+    ok=fscanf(f,"%lld %ld",&sec,&nsec)==2 &&
+      sec==dirs[i].mtime.tv_sec && nsec==dirs[i].mtime.tv_nsec;
+  }
+  if (ok && getline(&line,&n,f)!=-1)
+    while ((len=getline(&line,&n,f))>0) {
+      line[len-1]=0;
+      char *sp=strchr(line,' ');
+      if (!sp)
+	break;
+      *sp=0;
+      if (trusted(line,sp+1))
+	addHash(line,sp+1);
+    }
+  free(line);
+  fclose(f);
+}
+
+extern void writeHash() {
+  char *file=cachefile();
+  if (!path || !file)
+    return;
+  char *slash=strrchr(file,'/');
+  *slash=0;
+  mkdir(file,0700);		// ~/.cache may not exist yet
+  *slash='/';
+  unlink(file);			// so a file that is not ours is not reused
+  int fd=open(file,O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW|O_CLOEXEC,0600);
+  FILE *f=fd==-1 ? 0 : fdopen(fd,"w");
+  if (!f) {
+    if (fd!=-1)
+      close(fd);
+    return;
+  }
+  fprintf(f,"%s\n",path);
+  for (int i=0; i<ndirs; i++)
+    fprintf(f,"%lld %ld ",(long long)dirs[i].mtime.tv_sec,
+	    dirs[i].mtime.tv_nsec);
+  fprintf(f,"\n");
+  for (int i=0; i<size; i++)
+    if (table[i].name)
+      fprintf(f,"%s %s\n",table[i].name,table[i].path);
+  fclose(f);
+}
+
+extern void freeHash() {
+  clearHash();
+  free(table);
+  table=0;
+  size=0;
+  forgetdirs();
+}
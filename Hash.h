@@ -0,0 +1,18 @@
+#ifndef HASH_H
+#define HASH_H
+
+// A table of command locations, keyed by command name, in the style of
+// sh's "hash" builtin. Entries are dropped when PATH changes, or when
+// the modification time of a PATH directory changes. The table is kept
+// between shells in $XDG_CACHE_HOME/shell-hash, or ~/.cache/shell-hash.
+
+extern char *lookupHash(char *name); // resolved path, or 0
+extern void addHash(char *name, char *path);
+extern void remHash(char *name);
+extern void clearHash();
+extern void printHash();
+extern void readHash();		// the user's cache file, if it is safe
+extern void writeHash();
+extern void freeHash();
+
+#endif
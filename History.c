@@ -0,0 +1,483 @@
+/*
+ * Description:
+ *   History keeps readline's history list in a file, one entry per
+ *   line. The file stays open with O_APPEND, and each entry is written
+ *   as it is added, in one write(), so a crash loses nothing and
+ *   concurrent shells interleave whole lines rather than overwrite each
+ *   other. At startup only the last HISTFILESIZE lines are loaded,
+ *   found by scanning an mmap() of the file backward from its end, so
+ *   startup does not grow with the file.
+ *
+ *   Once the file has grown well past the cap, a forked child compacts
+ *   it to its last HISTFILESIZE lines: it writes them to a temporary
+ *   file and renames it over the original, holding an exclusive flock()
+ *   on the original meanwhile. Appenders hold a shared lock, and reopen
+ *   the file if it has been replaced since they opened it.
+ *
+ *   The entries are also kept here, numbered, with an index from each
+ *   trigram (three consecutive bytes) to the entries containing it. The
+ *   index is extended with the entries added since, at each search, so
+ *   startup does not pay for it. A search for a pattern of three or more
+ *   bytes checks only the entries on the pattern's rarest trigram's
+ *   list. The history builtin and ^R search through it.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <readline/readline.h>
+#include <readline/history.h>
+
+#include "History.h"
+#include "Stats.h"
+#include "error.h"
+
+#define CAP 10000		// lines, without HISTFILESIZE
+#define MODE 0600
+#define LINE 64			// bytes, a guess at an average line
+
+static char *path=0;
+static int fd=-1;
+static int cap=CAP;
+static off_t limit=0;		// compact once the file is larger
+
+typedef struct {
+  unsigned key;			// three bytes
+  int n;
+  int size;
+  int *ids;			// the entries containing it, ascending
+} Gram;
+
+static char **lines=0;		// entries, from id base
+static int room=0;
+static int base=0;
+static int low=0;		// the oldest entry kept
+static int next=0;		// the id of the next entry
+static int indexed=0;		// entries before this are indexed
+static Gram *grams=0;		// open addressing, by key
+static int ngrams=0;
+static int used=0;
+
+#define ENTRY(id) lines[(id)-base]
+#define KEY(s) ((unsigned char)(s)[0]<<16|(unsigned char)(s)[1]<<8| \
+		(unsigned char)(s)[2])
+
+// the gram for key, or the empty slot for it
+static Gram *slot(unsigned key) {
+  unsigned i=(key*2654435761u)&(ngrams-1);
+  while (grams[i].ids && grams[i].key!=key)
+    i=(i+1)&(ngrams-1);
+  return grams+i;
+}
+
+static Gram *gram(unsigned key, int make) {
+  if (make && 2*(used+1)>ngrams) {
+    Gram *old=grams;
+    int n=ngrams;
+    ngrams=n ? 2*n : 4096;
+    if (!(grams=calloc(ngrams,sizeof(*grams))))
+      ERROR("calloc() failed");
+    for (int i=0; i<n; i++)
+      if (old[i].ids)
+	*slot(old[i].key)=old[i];
+    free(old);
+  }
+  if (!ngrams)
+    return 0;
+  Gram *g=slot(key);
+  if (g->ids || !make)
+    return g->ids ? g : 0;
+  g->key=key;
+  g->n=0;
+  g->size=4;
+  if (!(g->ids=malloc(sizeof(*g->ids)*g->size)))
+    ERROR("malloc() failed");
+  used++;
+  return g;
+}
+
+// the index of the first id in g that is at least id
+static int from(Gram *g, int id) {
+  int lo=0, hi=g->n;
+  while (lo<hi) {
+    int mid=(lo+hi)/2;
+    if (g->ids[mid]<id)
+      lo=mid+1;
+    else
+      hi=mid;
+  }
+  return lo;
+}
+
+static void enter(int id, char *line) {
+  for (size_t i=0, len=strlen(line); i+3<=len; i++) {
+    Gram *g=gram(KEY(line+i),1);
+    if (g->n && g->ids[g->n-1]==id)
+      continue;
+    if (g->n==g->size) {	// drop the evicted, else grow
+      int gone=from(g,low);
+      memmove(g->ids,g->ids+gone,sizeof(*g->ids)*(g->n-=gone));
+      if (2*g->n>=g->size &&
+	  !(g->ids=realloc(g->ids,sizeof(*g->ids)*(g->size*=2))))
+	ERROR("realloc() failed");
+    }
+    g->ids[g->n++]=id;
+  }
+}
+
+// records an entry, evicting the oldest beyond the cap
+static void keep(char *line) {
+  if (next-base==room) {
+    int gone=low-base;		// slide out the evicted, else grow
+    memmove(lines,lines+gone,sizeof(*lines)*(next-low));
+    base=low;
+    if (2*(next-base)>=room &&
+	!(lines=realloc(lines,sizeof(*lines)*(room=room ? 2*room : 1024))))
+      ERROR("realloc() failed");
+  }
+  if (!(ENTRY(next)=strdup(line)))
+    ERROR("strdup() failed");
+  next++;
+  for (; next-low>cap; low++) {
+    free(ENTRY(low));
+    ENTRY(low)=0;
+  }
+  STATSET(history,next-low);
+}
+
+// indexes the entries added since the last search
+static void catchup() {
+  for (indexed=indexed>low ? indexed : low; indexed<next; indexed++)
+    enter(indexed,ENTRY(indexed));
+}
+
+// the rarest trigram of a pattern of three or more bytes, or 0
+static Gram *rarest(char *pattern, int *none) {
+  Gram *best=0;
+  *none=0;
+  catchup();
+  for (size_t i=0, len=strlen(pattern); i+3<=len; i++) {
+    Gram *g=gram(KEY(pattern+i),0);
+    if (!g) {
+      *none=1;			// in no entry at all
+      return 0;
+    }
+    if (!best || g->n<best->n)
+      best=g;
+  }
+  return best;
+}
+
+/**
+ * Returns the newest entry before id before that contains pattern, or
+ * -1.
+ */
+static int search(char *pattern, int before) {
+  int none;
+  Gram *g=rarest(pattern,&none);
+  if (none)
+    return -1;
+  if (!g) {
+    for (int id=before-1; id>=low; id--)
+      if (strstr(ENTRY(id),pattern))
+	return id;
+    return -1;
+  }
+  for (int i=from(g,before)-1; i>=0 && g->ids[i]>=low; i--)
+    if (strstr(ENTRY(g->ids[i]),pattern))
+      return g->ids[i];
+  return -1;
+}
+
+static int reopen() {
+  if (fd!=-1)
+    close(fd);
+  fd=open(path,O_RDWR|O_APPEND|O_CREAT|O_CLOEXEC,MODE);
+  if (fd==-1)
+    WARN("%s: %s",path,strerror(errno));
+  return fd;
+}
+
+/**
+ * Returns the start of the last n lines of a file's text. It is past
+ * the start of the text only if there are more than n lines.
+ */
+static char *tail(char *text, size_t size, int n) {
+  char *end=text+size;
+  if (end>text && end[-1]=='\n')
+    end--;			// the last line's own newline
+  for (int i=0; i<n; i++) {
+    char *nl=memrchr(text,'\n',end-text);
+    if (!nl)
+      return text;
+    end=nl;			// the newline before the i'th line from last
+  }
+  return end+1;
+}
+
+// the file's last lines, into readline's list
+static void load() {
+  struct stat st;
+  limit=(off_t)cap*LINE;	// not before the cap could be reached
+  if (fstat(fd,&st) || !st.st_size)
+    return;
+  char *text=mmap(0,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+  if (text==MAP_FAILED)
+    return;
+  char *p=tail(text,st.st_size,cap);
+  char *end=text+st.st_size;
+  if (p>text)
+    limit=0;			// more than the cap: compact soon
+  else if (limit<2*st.st_size)
+    limit=2*st.st_size;
+  char *line=0;
+  size_t size=0;
+  while (p<end) {
+    char *nl=memchr(p,'\n',end-p);
+    size_t len=(nl ? nl : end)-p;
+    if (len+1>size && !(line=realloc(line,size=2*(len+1))))
+      ERROR("realloc() failed");
+    memcpy(line,p,len);
+    line[len]=0;
+    if (len) {
+      add_history(line);
+      keep(line);
+    }
+    p+=len+1;
+  }
+  free(line);
+  munmap(text,st.st_size);
+}
+
+// ^R: searches back through the entries, as a pattern is typed
+static int isearch(int count, int key) {
+  char pattern[256]="";
+  int len=0, at=next;		// the entry shown; next is none
+  char *saved=strdup(rl_line_buffer);
+  if (!saved)
+    ERROR("strdup() failed");
+  rl_save_prompt();
+  for (;;) {
+    rl_message("(reverse-i-search)`%s': ",pattern);
+    int c=rl_read_key(), id=at;
+    if (c==CTRL('R'))
+      id=search(pattern,at);
+    else if ((c==RUBOUT || c==CTRL('H')) && len) {
+      pattern[--len]=0;
+      id=search(pattern,next);
+    } else if (c>=' ' && c<RUBOUT && len<sizeof(pattern)-1) {
+      pattern[len++]=c;
+      pattern[len]=0;
+      id=search(pattern,at==next ? next : at+1);
+    } else {
+      if (c==CTRL('G') || c==ESC) {
+	rl_replace_line(saved,0);
+	rl_point=strlen(saved);
+      } else if (c=='\n' || c=='\r')
+	rl_newline(1,c);
+      else
+	rl_execute_next(c);
+      break;
+    }
+    if (id<0) {
+      rl_ding();
+      continue;
+    }
+    at=id;
+    if (at<next) {
+      rl_replace_line(ENTRY(at),0);
+      rl_point=strstr(ENTRY(at),pattern)-ENTRY(at);
+    }
+  }
+  rl_restore_prompt();
+  rl_clear_message();
+  free(saved);
+  return 0;
+}
+
+extern void openHistory(char *file) {
+  char *s=getenv("HISTFILESIZE");
+  if (s && *s)
+    cap=atoi(s);
+  if (cap<=0)
+    cap=CAP;
+  path=strdup(file);
+  if (!path)
+    ERROR("strdup() failed");
+  using_history();
+  stifle_history(cap);
+  rl_bind_keyseq("\\C-r",isearch);
+  if (reopen()!=-1)
+    load();
+}
+
+// rewrites the file as its last cap lines; runs in a child
+static void compact() {
+  int in=open(path,O_RDONLY|O_CLOEXEC);
+  if (in==-1 || flock(in,LOCK_EX))
+    _exit(1);
+  struct stat st;
+  if (fstat(in,&st) || !st.st_size)
+    _exit(0);
+  char *text=mmap(0,st.st_size,PROT_READ,MAP_PRIVATE,in,0);
+  if (text==MAP_FAILED)
+    _exit(1);
+  char *p=tail(text,st.st_size,cap);
+  if (p==text)
+    _exit(0);			// within the cap already
+  char *tmp;
+  if (asprintf(&tmp,"%s.%d",path,getpid())==-1)
+    _exit(1);
+  int out=open(tmp,O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC,MODE);
+  if (out==-1)
+    _exit(1);
+  size_t len=text+st.st_size-p;
+  if (write(out,p,len)!=len || fsync(out) || close(out) ||
+      rename(tmp,path)) {
+    unlink(tmp);
+    _exit(1);
+  }
+  _exit(0);			// and the lock goes with the last descriptor
+}
+
+/**
+ * Adds a line to readline's list, and appends it to the file, reopening
+ * the file first if another shell has compacted it meanwhile.
+ */
+extern void addHistory(char *line) {
+  add_history(line);
+  keep(line);
+  if (fd==-1)
+    return;
+  struct stat mine, now;
+  for (;;) {
+    if (flock(fd,LOCK_SH))
+      return;
+    if (fstat(fd,&mine) || stat(path,&now) || mine.st_ino==now.st_ino)
+      break;
+    if (reopen()==-1)
+      return;
+  }
+  size_t len=strlen(line);
+  struct iovec iov[2]={{line,len},{"\n",1}};
+  if (writev(fd,iov,2)!=len+1)	// one append, so lines do not interleave
+    WARN("%s: %s",path,strerror(errno));
+  flock(fd,LOCK_UN);
+  off_t size=mine.st_size+len+1;
+  if (size<=limit)
+    return;
+  limit=2*size;
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid=fork();		// reaped, and ignored, by Jobs
+  if (!pid)
+    compact();
+  if (pid==-1)
+    WARN("fork() failed");
+}
+
+#define IOVS 1020		// a multiple of 3, within IOV_MAX
+
+// writes n buffers, the whole of each
+static void flush(struct iovec *iov, int n) {
+  while (n) {
+    ssize_t done=writev(STDOUT_FILENO,iov,n);
+    if (done==-1) {
+      if (errno==EINTR)
+	continue;
+      return;
+    }
+    for (; n && done>=iov->iov_len; iov++, n--)
+      done-=iov->iov_len;
+    if (n) {
+      iov->iov_base=(char *)iov->iov_base+done;
+      iov->iov_len-=done;
+    }
+  }
+}
+
+// lists the entries in ids (or all of first..next, if ids is 0)
+static void list(int *ids, int n, int first) {
+  struct iovec iov[IOVS];
+  char nums[IOVS/3][16];
+  int k=0;
+  fflush(stdout);
+  for (int i=0; i<n; i++) {
+    int id=ids ? ids[i] : first+i;
+    char *num=nums[k/3];
+    iov[k++]=(struct iovec){num,sprintf(num,"%d: ",id+1)};
+    iov[k++]=(struct iovec){ENTRY(id),strlen(ENTRY(id))};
+    iov[k++]=(struct iovec){"\n",1};
+    if (k==IOVS) {
+      flush(iov,k);
+      k=0;
+    }
+  }
+  flush(iov,k);
+}
+
+/**
+ * Lists the last n entries, or all of them if n is not positive.
+ */
+extern void printHistory(int n) {
+  int first=n>0 && next-n>low ? next-n : low;
+  list(0,next-first,first);
+}
+
+/**
+ * Lists the entries that contain pattern, oldest first.
+ */
+extern void searchHistory(char *pattern) {
+  int none, n=0, size=64;
+  Gram *g=rarest(pattern,&none);
+  if (none)
+    return;
+  int *ids=malloc(sizeof(*ids)*size);
+  if (!ids)
+    ERROR("malloc() failed");
+  int i=g ? from(g,low) : low, end=g ? g->n : next;
+  for (; i<end; i++) {
+    int id=g ? g->ids[i] : i;
+    if (!strstr(ENTRY(id),pattern))
+      continue;
+    if (n==size && !(ids=realloc(ids,sizeof(*ids)*(size*=2))))
+      ERROR("realloc() failed");
+    ids[n++]=id;
+  }
+  list(ids,n,0);
+  free(ids);
+}
+
+// forgets every entry, but not the file
+extern void clearHistory() {
+  clear_history();
+  for (int id=low; id<next; id++)
+    free(ENTRY(id));
+  for (int i=0; i<ngrams; i++)
+    free(grams[i].ids);
+  free(grams);
+  free(lines);
+  lines=0;
+  grams=0;
+  room=ngrams=used=0;
+  base=low=next=indexed=0;
+  STATSET(history,0);
+}
+
+extern void closeHistory() {
+  if (fd!=-1)
+    close(fd);
+  fd=-1;
+  free(path);
+  path=0;
+  clearHistory();
+}
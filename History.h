@@ -0,0 +1,15 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+// The interactive shell's history file, appended to as each line is
+// entered, and kept to a cap of lines (HISTFILESIZE). Its entries are
+// indexed by trigram, for the history builtin and ^R.
+
+extern void openHistory(char *file);
+extern void addHistory(char *line);
+extern void printHistory(int n);
+extern void searchHistory(char *pattern);
+extern void clearHistory();
+extern void closeHistory();
+
+#endif
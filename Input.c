@@ -0,0 +1,183 @@
+/*
+ * Description:
+ *   Input reads the lines of a script, or of stdin when it is not a
+ *   terminal, without readline's per-character processing. A regular
+ *   file is mmap()ed, privately, and each line is terminated in place;
+ *   anything else is read() a large block at a time. Either way, lines
+ *   are found with memchr(), and not copied.
+ *
+ *   When the shell's stdin is a regular file, its offset is kept just
+ *   past the line last returned, so a command that reads stdin sees the
+ *   rest of the script, and the shell goes on after what it read, as in
+ *   sh. Other seekable input is read ahead, and then sought back to the
+ *   end of the line; a pipe, which cannot be, is read a byte at a time,
+ *   as sh does, so nothing after the line is taken from commands.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "Input.h"
+#include "error.h"
+
+#define BLOCK (1<<16)
+
+typedef struct {
+  int fd;
+  char *map;			// the mapped file, or 0
+  size_t size;			// of the map, or of buf
+  size_t pos;			// next unread byte
+  size_t len;			// bytes in buf
+  char *buf;			// read() data, or a last line with no newline
+  int sync;			// keep fd's offset at pos
+  int bytewise;			// stdin that cannot seek: read no further
+  int text;			// map is a string, not a mapped file
+  int eof;			// read() has returned 0
+} *InputRep;
+
+extern Input newInput(int fd) {
+  InputRep r=(InputRep)malloc(sizeof(*r));
+  if (!r)
+    ERROR("malloc() failed");
+  memset(r,0,sizeof(*r));
+  r->fd=fd;
+  struct stat st;
+  if (!fstat(fd,&st) && S_ISREG(st.st_mode) && st.st_size>0) {
+    off_t at=lseek(fd,0,SEEK_CUR);
+    r->map=mmap(0,st.st_size,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+    if (r->map==MAP_FAILED)
+      r->map=0;
+    else {
+      r->size=st.st_size;
+      r->pos=at>0 ? at : 0;
+      r->sync=fd==STDIN_FILENO;
+    }
+  } else if (fd==STDIN_FILENO) {
+    r->sync=lseek(fd,0,SEEK_CUR)!=-1;
+    r->bytewise=!r->sync;
+  }
+  return r;
+}
+
+/**
+ * Reads the lines of a string, e.g., from -c. The string is modified,
+ * and must outlive the Input.
+ */
+extern Input textInput(char *s) {
+  InputRep r=(InputRep)malloc(sizeof(*r));
+  if (!r)
+    ERROR("malloc() failed");
+  memset(r,0,sizeof(*r));
+  r->fd=-1;
+  r->map=s;
+  r->size=strlen(s);
+  r->text=1;
+  return r;
+}
+
+// the rest of the mapped file, with no newline, copied to be terminated
+static char *last(InputRep r) {
+  size_t n=r->size-r->pos;
+  free(r->buf);
+  if (!(r->buf=malloc(n+1)))
+    ERROR("malloc() failed");
+  memcpy(r->buf,r->map+r->pos,n);
+  r->buf[n]=0;
+  r->pos=r->size;
+  return r->buf;
+}
+
+static char *mapped(InputRep r) {
+  if (r->sync) {		// a command may have read some of it
+    off_t at=lseek(r->fd,0,SEEK_CUR);
+    if (at>(off_t)r->pos)
+      r->pos=at;
+  }
+  if (r->pos>=r->size)
+    return 0;
+  char *line=r->map+r->pos;
+  char *nl=memchr(line,'\n',r->size-r->pos);
+  if (!nl)
+    line=last(r);
+  else {
+    *nl=0;
+    r->pos=nl+1-r->map;
+  }
+  if (r->sync)
+    lseek(r->fd,r->pos,SEEK_SET);
+  return line;
+}
+
+static char *buffered(InputRep r) {
+  size_t from=r->pos;		// no newline before this
+  for (;;) {
+    char *line=r->buf+r->pos;
+    char *nl=r->buf ? memchr(r->buf+from,'\n',r->len-from) : 0;
+    if (nl) {
+      *nl=0;
+      r->pos=nl+1-r->buf;
+      if (r->sync) {		// give back what was read past the line
+	lseek(r->fd,-(off_t)(r->len-r->pos),SEEK_CUR);
+	r->len=r->pos;
+      }
+      return line;
+    }
+    // keep the partial line, and read after it
+    r->len-=r->pos;
+    memmove(r->buf,line,r->len);
+    r->pos=0;
+    from=r->len;
+    if (r->size-r->len<BLOCK) {
+      r->size=r->size ? 2*r->size : BLOCK+1;
+      if (!(r->buf=realloc(r->buf,r->size)))
+	ERROR("realloc() failed");
+    }
+    ssize_t n=read(r->fd,r->buf+r->len,r->bytewise ? 1 : r->size-r->len-1);
+    if (n==-1 && errno==EINTR)
+      continue;
+    if (n<=0) {
+      r->eof=1;
+      if (!r->len)
+	return 0;
+      r->buf[r->len]=0;	// a last line with no newline
+      r->pos=r->len;
+      return r->buf;
+    }
+    r->len+=n;
+  }
+}
+
+extern char *readInput(Input input) {
+  InputRep r=(InputRep)input;
+  return r->map ? mapped(r) : buffered(r);
+}
+
+/**
+ * Returns whether the line last read is known to be the last, without
+ * waiting for more input. Trailing blank lines do not count.
+ */
+extern int endInput(Input input) {
+  InputRep r=(InputRep)input;
+  char *s=r->map ? r->map : r->buf;
+  size_t end=r->map ? r->size : r->len;
+  if (!r->map && !r->eof)
+    return 0;
+  for (size_t i=r->pos; i<end; i++)
+    if (!strchr(" \t\r\n",s[i]))
+      return 0;
+  return 1;
+}
+
+extern void freeInput(Input input) {
+  InputRep r=(InputRep)input;
+  if (r->map && !r->text)
+    munmap(r->map,r->size);
+  free(r->buf);
+  free(r);
+}
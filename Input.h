@@ -0,0 +1,15 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+typedef void *Input;
+
+// Lines of a script, or of a non-interactive stdin, without readline. A
+// line is returned without its newline, and is valid until the next call.
+
+extern Input newInput(int fd);
+extern Input textInput(char *s);
+extern char *readInput(Input input); // 0 at end of input
+extern int endInput(Input input);
+extern void freeInput(Input input);
+
+#endif
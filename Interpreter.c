@@ -6,17 +6,19 @@
 #include "Sequence.h"
 #include "Pipeline.h"
 #include "Command.h"
+#include "Control.h"
 
 static Command i_command(T_command t);
 static void i_pipeline(T_pipeline t, Pipeline pipeline);
 static void i_sequence(T_sequence t, Sequence sequence);
+static Control i_control(T_control t);
 
 static Command i_command(T_command t) {
   if (!t)
     return 0;
   Command command=0;
   if (t->words)
-    command=newCommand(t->words);
+    command=newCommand(t->words,t->redir);
   return command;
 }
 
@@ -27,32 +29,58 @@ static void i_pipeline(T_pipeline t, Pipeline pipeline) {
   i_pipeline(t->pipeline,pipeline);
 }
 
+// a list inside a compound command, as a Sequence of its own
+static Sequence i_list(T_sequence t) {
+  Sequence sequence=newSequence();
+  i_sequence(t,sequence);
+  return sequence;
+}
+
+// an elif is an if in the else part
+static Control i_control(T_control t) {
+  if (!strcmp(t->kind,"while"))
+    return whileControl(i_list(t->cond),i_list(t->body));
+  if (!strcmp(t->kind,"for"))
+    return forControl(t->name,t->words,i_list(t->body));
+  Sequence otherwise=0;
+  if (t->elif) {
+    otherwise=newSequence();
+    controlSequence(otherwise,i_control(t->elif));
+  } else if (t->otherwise)
+    otherwise=i_list(t->otherwise);
+  return ifControl(i_list(t->cond),i_list(t->body),otherwise);
+}
+
 static void i_sequence(T_sequence t, Sequence sequence) {
   if (!t)
     return;
+  if (t->control) {
+    controlSequence(sequence,i_control(t->control));
+    opSequence(sequence,t->op);
+    i_sequence(t->sequence,sequence);
+    return;
+  }
   int fg = 1;
-  if(t->op != NULL){
-    // if(strcmp(t->op,"&")){ // Run in background
-    //   fg = 0;
-    // } else if(strcmp(t->op,";")){ // Run in foreground(?)
-    //   fg = 1;
-    // } else {
-    //   fg = 0; 
-    // }
+  if (t->op && !strcmp(t->op,"&")) // Run in background
     fg = 0;
-    //printf("%s\n", t->op); // throws segmentation fault if empty
-  }
 
   Pipeline pipeline=newPipeline(fg);
+  if (t->timed)
+    timePipeline(pipeline);
   i_pipeline(t->pipeline,pipeline);
   addSequence(sequence,pipeline);
+  opSequence(sequence,t->op);
   i_sequence(t->sequence,sequence);
 }
 
-extern void interpretTree(Tree t, int *eof, Jobs jobs) {
+/**
+ * Builds the Sequence of Pipelines of Commands for a tree, which no
+ * longer refers to the tree. Returns 0 for an empty tree.
+ */
+extern Sequence interpretTree(Tree t) {
   if (!t)
-    return;
+    return 0;
   Sequence sequence=newSequence();
   i_sequence(t,sequence);
-  execSequence(sequence,jobs,eof); 
+  return sequence;
 }
@@ -3,8 +3,8 @@
 
 #include "Parser.h"
 #include "Tree.h"
-#include "Jobs.h"
+#include "Sequence.h"
 
-extern void interpretTree(Tree t, int *eof, Jobs jobs);
+extern Sequence interpretTree(Tree t);
 
 #endif
@@ -1,19 +1,852 @@
+/* 
+ * Description: 
+ *   Jobs is the table of running pipelines. A job records the pids of
+ *   its pipeline's processes, and a table maps each pid back to its
+ *   job. Children are reaped as soon as they exit, by a SIGCHLD handler
+ *   that wait4()s them into a ring of (pid, status, rusage) records;
+ *   the shell drains the ring into the table between commands, or while
+ *   waiting for a job. A background job's Pipeline is freed at the first
+ *   reapJobs() after all of its processes are reaped; its id, pids, and
+ *   exit status are kept until "wait" or "wait -n" collects them.
+ *
+ *   With job control (an interactive shell), each pipeline is its own
+ *   process group, a foreground job is given the terminal, and a job
+ *   stopped with ^Z can be continued with fg or bg.
+ *
+ *   Background pipelines are admitted up to a limit on running jobs
+ *   (SHELL_JOBMAX, or the jobmax builtin; by default the number of
+ *   online CPUs), and optionally only while the load average is below
+ *   a ceiling. The rest wait in a FIFO, and are started as running jobs
+ *   are reaped. With nothing running, one is always started.
+ * 
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
 #include "Jobs.h"
+#include "Trace.h"
+#include "Stats.h"
 #include "deq.h"
 #include "error.h"
 
+typedef enum {Running,Stopped,Done} State;
+
+typedef struct {
+  int id;
+  Pipeline pipeline;
+  pid_t pgid;			// 0 without job control
+  int n;			// processes
+  int live;			// processes not yet reaped
+  int stopped;			// live processes that are stopped
+  int waited;			// someone is waiting for this job
+  pid_t *pids;
+  int *status;			// as from wait4(), per process
+  char *state;			// State, per process
+  struct rusage ru;		// summed over the reaped processes
+} *Job;
+
+typedef struct {
+  pid_t pid;
+  Job job;
+} Slot;
+
+typedef struct {
+  Deq jobs;			// Job, in start order
+  Slot *table;			// pid -> Job, open addressing
+  int size;
+  int used;
+  int tty;			// the terminal, with job control, else -1
+  Deq exited;			// finished background jobs, not yet waited for
+  Deq queued;			// background Pipelines not yet started
+  int max;			// running background jobs, at most; 0 is no limit
+  double load;			// load average ceiling; 0 is none
+  int *last;			// exit statuses of the last job waited for,
+  int nlast;			// per process,
+  struct rusage ru;		// and its resource usage
+} *JobsRep;
+
+#define EXITED 1024		// at most this many finished jobs are kept
+
+// Filled by the SIGCHLD handler, and drained with SIGCHLD blocked, so
+// the two never run at once.
+typedef struct {
+  pid_t pid;
+  int status;
+  struct rusage ru;
+} Reaped;
+
+#define RING 256
+static Reaped ring[RING];
+static volatile sig_atomic_t first=0;
+static volatile sig_atomic_t count=0;
+static volatile sig_atomic_t overflow=0; // children left for drain()
+static volatile sig_atomic_t interrupted=0; // ^C, in a job control shell
+
+#define WAITFLAGS (WNOHANG|WUNTRACED|WCONTINUED)
+
+static int code(int status);
+
+// a child's exit, for Trace, as it is reaped
+#define TRACEEXIT(pid,status) do {				\
+  if (WIFEXITED(status) || WIFSIGNALED(status))			\
+    TRACE(TraceExit,"child",pid,code(status));			\
+} while (0)
+
+static void onchld(int sig) {
+  int saved=errno;
+  for (;;) {
+    if (count==RING) {
+      overflow=1;
+      break;
+    }
+    Reaped *p=ring+(first+count)%RING;
+    pid_t pid=wait4(-1,&p->status,WAITFLAGS,&p->ru);
+    if (pid<=0)
+      break;
+    TRACEEXIT(pid,p->status);
+    p->pid=pid;
+    count++;
+  }
+  errno=saved;
+}
+
+// not SA_RESTART, so a builtin blocked in read() sees EINTR, and stops
+static void onint(int sig) {
+  interrupted=1;
+}
+
+static void block(sigset_t *old) {
+  sigset_t set;
+  sigemptyset(&set);
+  sigaddset(&set,SIGCHLD);
+  sigprocmask(SIG_BLOCK,&set,old);
+}
+
+static void unblock(sigset_t *old) {
+  sigprocmask(SIG_SETMASK,old,0);
+}
+
 extern Jobs newJobs() {
-  return deq_new();
+  JobsRep r=(JobsRep)malloc(sizeof(*r));
+  if (!r)
+    ERROR("malloc() failed");
+  r->jobs=deq_new();
+  r->size=64;
+  r->used=0;
+  r->table=calloc(r->size,sizeof(*r->table));
+  if (!r->table)
+    ERROR("calloc() failed");
+  r->tty=-1;
+  r->exited=deq_new();
+  r->queued=deq_new();
+  char *max=getenv("SHELL_JOBMAX");
+  r->max=max ? atoi(max) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (r->max<0)
+    r->max=0;
+  r->load=0;
+  r->last=0;
+  r->nlast=0;
+  memset(&r->ru,0,sizeof(r->ru));
+
+  struct sigaction sa;
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler=onchld;
+  sa.sa_flags=SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGCHLD,&sa,0);
+  return r;
+}
+
+/**
+ * Turns on job control: the shell takes the terminal in its own process
+ * group, and ignores the signals a job control shell must not stop on.
+ * SIGINT is caught, so that ^C stops a builtin running in the shell,
+ * not the shell. Children set these back to their defaults.
+ */
+extern void controlJobs(Jobs jobs, int tty) {
+  JobsRep r=(JobsRep)jobs;
+  signal(SIGTTOU,SIG_IGN);
+  signal(SIGTTIN,SIG_IGN);
+  signal(SIGTSTP,SIG_IGN);
+  signal(SIGQUIT,SIG_IGN);
+  struct sigaction sa;
+  memset(&sa,0,sizeof(sa));
+  sa.sa_handler=onint;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT,&sa,0);
+  setpgid(0,0);
+  tcsetpgrp(tty,getpgrp());
+  r->tty=tty;
+}
+
+// whether ^C was typed since the last call
+extern int interruptJobs(Jobs jobs) {
+  int was=interrupted;
+  interrupted=0;
+  return was;
+}
+
+// the terminal, if each pipeline gets its own process group, else -1
+extern int ttyJobs(Jobs jobs) {
+  return ((JobsRep)jobs)->tty;
+}
+
+static Slot *find(JobsRep r, pid_t pid) {
+  for (unsigned i=pid&(r->size-1); r->table[i].pid; i=(i+1)&(r->size-1))
+    if (r->table[i].pid==pid)
+      return r->table+i;
+  return 0;
+}
+
+static void insert(JobsRep r, pid_t pid, Job job) {
+  if (2*(r->used+1)>r->size) {
+    Slot *old=r->table;
+    int n=r->size;
+    r->size*=2;
+    r->table=calloc(r->size,sizeof(*r->table));
+    if (!r->table)
+      ERROR("calloc() failed");
+    r->used=0;
+    for (int i=0; i<n; i++)
+      if (old[i].pid)
+	insert(r,old[i].pid,old[i].job);
+    free(old);
+  }
+  unsigned i=pid&(r->size-1);
+  while (r->table[i].pid)
+    i=(i+1)&(r->size-1);
+  r->table[i]=(Slot){pid,job};
+  r->used++;
+}
+
+static void unmap(JobsRep r, Slot *s) {
+  s->pid=0;
+  r->used--;
+  // re-insert the rest of the probe run, so lookups still reach it
+  for (unsigned i=(s-r->table+1)&(r->size-1); r->table[i].pid;
+       i=(i+1)&(r->size-1)) {
+    Slot moved=r->table[i];
+    r->table[i].pid=0;
+    r->used--;
+    insert(r,moved.pid,moved.job);
+  }
+}
+
+// the stages of a pipeline run at once, so their max RSSs add up too
+static void addru(struct rusage *sum, struct rusage *ru) {
+  timeradd(&sum->ru_utime,&ru->ru_utime,&sum->ru_utime);
+  timeradd(&sum->ru_stime,&ru->ru_stime,&sum->ru_stime);
+  sum->ru_maxrss+=ru->ru_maxrss;
+}
+
+// a wait status as a shell exit status
+static int code(int status) {
+  if (WIFEXITED(status))
+    return WEXITSTATUS(status);
+  if (WIFSIGNALED(status))
+    return 128+WTERMSIG(status);
+  return 0;
+}
+
+// keeps a waited-for job's statuses, and usage, for statusJobs()
+static void keep(JobsRep r, Job job) {
+  if (!(r->last=realloc(r->last,sizeof(*r->last)*job->n)))
+    ERROR("realloc() failed");
+  for (int i=0; i<job->n; i++)
+    r->last[i]=job->state[i]==Stopped ? 128+SIGTSTP : code(job->status[i]);
+  r->nlast=job->n;
+  r->ru=job->ru;
+}
+
+static void freeJob(Data d) {
+  Job job=d;
+  if (job->pipeline)
+    freePipeline(job->pipeline);
+  free(job->pids);
+  free(job->status);
+  free(job->state);
+  free(job);
+}
+
+static void finish(JobsRep r, Job job) {
+  deq_head_rem(r->jobs,job);
+  STAT(jobs,-1);
+  freeJob(job);
+}
+
+static void reaped(JobsRep r, Reaped *x) {
+  Slot *s=find(r,x->pid);
+  if (!s)
+    return;			// not one of ours
+  Job job=s->job;
+  int i=0;
+  while (job->pids[i]!=x->pid)
+    i++;
+  if (WIFSTOPPED(x->status)) {
+    if (job->state[i]==Running) {
+      job->state[i]=Stopped;
+      job->stopped++;
+    }
+    return;
+  }
+  if (WIFCONTINUED(x->status)) {
+    if (job->state[i]==Stopped) {
+      job->state[i]=Running;
+      job->stopped--;
+    }
+    return;
+  }
+  if (job->state[i]==Stopped)
+    job->stopped--;
+  job->state[i]=Done;
+  job->status[i]=x->status;
+  addru(&job->ru,&x->ru);
+  STAT(reaped,1);
+  STAT(utime,x->ru.ru_utime.tv_sec*1000000+x->ru.ru_utime.tv_usec);
+  STAT(stime,x->ru.ru_stime.tv_sec*1000000+x->ru.ru_stime.tv_usec);
+  unmap(r,s);
+  job->live--;
+}
+
+// moves reaped children into the table; SIGCHLD must be blocked
+static void drain(JobsRep r) {
+  while (count) {
+    Reaped x=ring[first];
+    first=(first+1)%RING;
+    count--;
+    reaped(r,&x);
+  }
+  if (overflow) {
+    overflow=0;
+    Reaped x;
+    while ((x.pid=wait4(-1,&x.status,WAITFLAGS,&x.ru))>0) {
+      TRACEEXIT(x.pid,x.status);
+      reaped(r,&x);
+    }
+  }
+}
+
+static char *text(Job job) {
+  return strPipeline(job->pipeline);
+}
+
+static void report(Job job, char *what) {
+  char *s=text(job);
+  printf("[%d]  %-10s%s\n",job->id,what,s);
+  free(s);
+}
+
+/**
+ * Moves the finished background jobs to the exited list, without their
+ * pipelines, until something waits for them.
+ */
+static void tidy(JobsRep r, int notify) {
+  for (int i=0; i<deq_len(r->jobs); ) {
+    Job job=deq_head_ith(r->jobs,i);
+    if (job->live || job->waited) {
+      i++;
+      continue;
+    }
+    if (notify)
+      report(job,"Done");
+    if (deq_len(r->exited)==EXITED)
+      freeJob(deq_head_get(r->exited));
+    deq_head_rem(r->jobs,job);
+    STAT(jobs,-1);
+    freePipeline(job->pipeline);
+    job->pipeline=0;
+    deq_tail_put(r->exited,job);
+  }
+}
+
+// whether another background job may start now
+static int room(JobsRep r) {
+  int running=0;
+  for (int i=0; i<deq_len(r->jobs); i++) {
+    Job job=deq_head_ith(r->jobs,i);
+    running+=job->pipeline && !fgPipeline(job->pipeline) &&
+      job->stopped<job->live;
+  }
+  if (!running)
+    return 1;
+  if (r->max && running>=r->max)
+    return 0;
+  double avg;
+  if (r->load>0 && getloadavg(&avg,1)==1 && avg>=r->load)
+    return 0;
+  return 1;
+}
+
+// starts queued pipelines while there is room
+static void admit(JobsRep r) {
+  while (deq_len(r->queued) && room(r)) {
+    int eof=0;
+    STAT(queued,-1);
+    runPipeline(deq_head_get(r->queued),r,&eof);
+  }
+}
+
+/**
+ * Queues a background pipeline if it may not start yet, or if others
+ * are already waiting. Returns whether it was queued; the queue then
+ * owns it.
+ */
+extern int queueJobs(Jobs jobs, Pipeline pipeline) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  drain(r);
+  int queue=deq_len(r->queued) || !room(r);
+  if (queue) {
+    deq_tail_put(r->queued,pipeline);
+    STAT(queued,1);
+  }
+  unblock(&old);
+  return queue;
+}
+
+/**
+ * Sets the limit on running background jobs (0 is none), and the load
+ * average ceiling (0 is none). A negative value leaves one unchanged.
+ */
+extern void limitJobs(Jobs jobs, int max, double load) {
+  JobsRep r=(JobsRep)jobs;
+  if (max>=0)
+    r->max=max;
+  if (load>=0)
+    r->load=load;
+  pollJobs(jobs);
+}
+
+extern int maxJobs(Jobs jobs, double *load) {
+  JobsRep r=(JobsRep)jobs;
+  *load=r->load;
+  return r->max;
+}
+
+/**
+ * Records a started pipeline as a job, which then owns the pipeline.
+ * Returns the job's id: one more than the newest job's. A job without
+ * a pipeline belongs to a builtin (pmap), which must wait for it: it is
+ * neither listed, reported, nor counted against the limit.
+ */
+extern int addJobs(Jobs jobs, Pipeline pipeline, pid_t *pids, int n,
+		   pid_t pgid) {
+  JobsRep r=(JobsRep)jobs;
+  Job job=(Job)malloc(sizeof(*job));
+  if (!job)
+    ERROR("malloc() failed");
+  memset(job,0,sizeof(*job));
+  job->pipeline=pipeline;
+  job->pgid=pgid;
+  job->waited=!pipeline;
+  job->n=job->live=n;
+  job->pids=malloc(sizeof(*job->pids)*n);
+  job->status=calloc(n,sizeof(*job->status));
+  job->state=calloc(n,sizeof(*job->state));
+  if (!job->pids || !job->status || !job->state)
+    ERROR("malloc() failed");
+  memcpy(job->pids,pids,sizeof(*pids)*n);
+
+  sigset_t old;
+  block(&old);
+  job->id=1;			// past the newest job, running or not
+  if (deq_len(r->jobs))
+    job->id=((Job)deq_tail_ith(r->jobs,0))->id+1;
+  if (deq_len(r->exited) && ((Job)deq_tail_ith(r->exited,0))->id>=job->id)
+    job->id=((Job)deq_tail_ith(r->exited,0))->id+1;
+  deq_tail_put(r->jobs,job);
+  STAT(jobs,1);
+  for (int i=0; i<n; i++)
+    insert(r,pids[i],job);
+  unblock(&old);
+  if (r->tty>=0 && pipeline && !fgPipeline(pipeline))
+    fprintf(stderr,"[%d] %d\n",job->id,pids[n-1]);
+  return job->id;
+}
+
+static Job idin(Deq q, int id) {
+  for (int i=0; i<deq_len(q); i++) {
+    Job job=deq_head_ith(q,i);
+    if (job->id==id)
+      return job;
+  }
+  return 0;
+}
+
+static Job byid(JobsRep r, int id) {
+  return idin(r->jobs,id);
+}
+
+/**
+ * Returns the id of the job named by spec, or 0: %n is job n, % %% and
+ * %+ are the newest job, %- the one before it, and a number is the job
+ * with that pid. %n and a pid may also name a finished job that has
+ * not been waited for.
+ */
+extern int findJobs(Jobs jobs, char *spec) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  drain(r);
+  unblock(&old);
+  int n=deq_len(r->jobs);
+  char *end;
+  if (*spec=='%') {
+    spec++;
+    if (!*spec || !strcmp(spec,"%") || !strcmp(spec,"+"))
+      return n ? ((Job)deq_tail_ith(r->jobs,0))->id : 0;
+    if (!strcmp(spec,"-"))
+      return n>1 ? ((Job)deq_tail_ith(r->jobs,1))->id : 0;
+    long id=strtol(spec,&end,10);
+    return (!*end && (byid(r,id) || idin(r->exited,id))) ? id : 0;
+  }
+  long pid=strtol(spec,&end,10);
+  if (*end || pid<=0)
+    return 0;
+  Slot *s=find(r,pid);
+  if (s)
+    return s->job->id;
+  for (Deq q=r->jobs; q; q=(q==r->jobs) ? r->exited : 0)
+    for (int i=0; i<deq_len(q); i++) { // reaped, or finished
+      Job job=deq_head_ith(q,i);
+      for (int j=0; j<job->n; j++)
+	if (job->pids[j]==pid)
+	  return job->id;
+    }
+  return 0;
+}
+
+static void signal_job(Job job, int sig) {
+  if (job->pgid) {
+    kill(-job->pgid,sig);
+    return;
+  }
+  for (int i=0; i<job->n; i++)
+    if (job->state[i]!=Done)
+      kill(job->pids[i],sig);
+}
+
+/**
+ * Continues a job's stopped processes. They are marked running now, not
+ * when the reports of their continuing are drained, so a wait for the
+ * job that follows does not see them as still stopped.
+ */
+static void resume(JobsRep r, Job job) {
+  sigset_t old;
+  block(&old);
+  drain(r);
+  for (int i=0; i<job->n; i++)
+    if (job->state[i]==Stopped)
+      job->state[i]=Running;
+  job->stopped=0;
+  signal_job(job,SIGCONT);
+  unblock(&old);
+}
+
+/**
+ * Waits until every process of a job has been reaped, or every one
+ * left has stopped. A finished job is freed, and its last process's
+ * exit status returned. A stopped job stays, and 128+SIGTSTP is
+ * returned. The foreground job is given the terminal meanwhile.
+ */
+static int await(JobsRep r, Job job, int fg) {
+  int status;
+  sigset_t old;
+  block(&old);
+  job->waited=1;
+  if (fg && r->tty>=0 && job->pgid)
+    tcsetpgrp(r->tty,job->pgid);
+  drain(r);
+  admit(r);
+  while (job->live && job->stopped<job->live) {
+    sigsuspend(&old);
+    drain(r);
+    admit(r);
+  }
+  if (fg && r->tty>=0)
+    tcsetpgrp(r->tty,getpgrp());
+  job->waited=0;
+  keep(r,job);
+  if (job->live) {
+    printf("\n");
+    report(job,"Stopped");
+    status=128+SIGTSTP;
+  } else {
+    status=code(job->status[job->n-1]);
+    finish(r,job);
+  }
+  unblock(&old);
+  return status;
+}
+
+/**
+ * Waits for a job, or collects one that has already finished. Returns
+ * its exit status, or 127 if there is no such job.
+ */
+extern int waitJobs(Jobs jobs, int id) {
+  JobsRep r=(JobsRep)jobs;
+  Job job=byid(r,id);
+  if (job)
+    return await(r,job,0);
+  sigset_t old;
+  block(&old);
+  int status=127;
+  if ((job=idin(r->exited,id))) {
+    deq_head_rem(r->exited,job);
+    keep(r,job);
+    status=code(job->status[job->n-1]);
+    freeJob(job);
+  }
+  unblock(&old);
+  return status;
+}
+
+/**
+ * Waits for every running background job. Finished jobs are no longer
+ * kept for "wait" or "wait -n".
+ */
+extern int waitallJobs(Jobs jobs) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  for (;;) {
+    drain(r);
+    tidy(r,0);
+    admit(r);
+    int running=0;
+    for (int i=0; i<deq_len(r->jobs); i++) {
+      Job job=deq_head_ith(r->jobs,i);
+      running|=job->stopped<job->live;
+    }
+    if (!running)
+      break;
+    sigsuspend(&old);
+  }
+  while (deq_len(r->exited))
+    freeJob(deq_head_get(r->exited));
+  unblock(&old);
+  return 0;
+}
+
+/**
+ * Waits for the next background job to finish, and returns its status.
+ * A job that finished since the last wait counts, so a script can keep
+ * N jobs running by starting one after each "wait -n". Returns 127 if
+ * there is nothing to wait for.
+ */
+extern int waitanyJobs(Jobs jobs) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  for (;;) {
+    drain(r);
+    tidy(r,0);
+    if (deq_len(r->exited))
+      break;
+    admit(r);
+    int running=0;
+    for (int i=0; i<deq_len(r->jobs); i++) {
+      Job job=deq_head_ith(r->jobs,i);
+      running|=!job->waited && job->stopped<job->live;
+    }
+    if (!running) {
+      unblock(&old);
+      return 127;
+    }
+    sigsuspend(&old);
+  }
+  Job job=deq_head_get(r->exited);
+  int status=code(job->status[job->n-1]);
+  freeJob(job);
+  unblock(&old);
+  return status;
+}
+
+/**
+ * Returns how many of the n jobs in ids still have a process that has
+ * not been reaped. With SIGCHLD blocked by the caller, their process
+ * groups then stay in existence, and may still be joined.
+ */
+extern int liveJobs(Jobs jobs, int *ids, int n) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  drain(r);
+  unblock(&old);
+  int live=0;
+  for (int i=0; i<n; i++) {
+    Job job=byid(r,ids[i]);
+    live+=job && job->live;
+  }
+  return live;
+}
+
+/**
+ * Waits until one of the n jobs in ids has finished, and frees it.
+ * Returns its index in ids, and stores its exit status in *status.
+ */
+extern int waitfirstJobs(Jobs jobs, int *ids, int n, int *status) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  for (;;) {
+    drain(r);
+    admit(r);
+    for (int i=0; i<n; i++) {
+      Job job=byid(r,ids[i]);
+      if (!job || !job->live) {
+	*status=job ? code(job->status[job->n-1]) : 127;
+	if (job)
+	  finish(r,job);
+	unblock(&old);
+	return i;
+      }
+    }
+    sigsuspend(&old);
+  }
+}
+
+// whether a job has finished, but is kept until it is waited for
+static int terminated(JobsRep r, int id, char *what) {
+  if (!idin(r->exited,id))
+    return 0;
+  WARN("%s: job has terminated",what);
+  return 1;
+}
+
+/**
+ * Continues a job, if it is stopped, and waits for it in the
+ * foreground. Returns its status, or 1 if it has already finished.
+ */
+extern int fgJobs(Jobs jobs, int id, int echo) {
+  JobsRep r=(JobsRep)jobs;
+  Job job=byid(r,id);
+  if (!job)
+    return terminated(r,id,"fg") ? 1 : 127;
+  if (echo) {
+    char *s=text(job);
+    printf("%s\n",s);
+    free(s);
+    fflush(stdout);
+  }
+  if (job->stopped) {
+    if (r->tty>=0 && job->pgid)
+      tcsetpgrp(r->tty,job->pgid);
+    resume(r,job);
+  }
+  return await(r,job,1);
+}
+
+/**
+ * Returns the exit statuses of each process of the job last waited for
+ * in the foreground, or by wait, in pipeline order, and stores how many
+ * there are in *n. If ru is not 0, their summed resource usage is stored
+ * there.
+ */
+extern int *statusJobs(Jobs jobs, int *n, struct rusage *ru) {
+  JobsRep r=(JobsRep)jobs;
+  *n=r->nlast;
+  if (ru)
+    *ru=r->ru;
+  return r->last;
+}
+
+// continues a job in the background; returns 0, or 1 if it has finished
+extern int bgJobs(Jobs jobs, int id) {
+  JobsRep r=(JobsRep)jobs;
+  Job job=byid(r,id);
+  if (!job)
+    return terminated(r,id,"bg") ? 1 : 127;
+  char *s=text(job);
+  printf("[%d]  %s &\n",job->id,s);
+  free(s);
+  resume(r,job);
+  return 0;
+}
+
+extern void printJobs(Jobs jobs, int pids) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  drain(r);
+  for (int i=0; i<deq_len(r->jobs); i++) {
+    Job job=deq_head_ith(r->jobs,i);
+    if (!job->pipeline)
+      continue;
+    char *what=!job->live ? "Done" : job->stopped==job->live ?
+      "Stopped" : "Running";
+    report(job,what);
+    for (int j=0; pids && j<job->n; j++)
+      printf("      %d %s\n",job->pids[j],
+	     job->state[j]==Done ? "done" :
+	     job->state[j]==Stopped ? "stopped" : "running");
+  }
+  for (int i=0; i<deq_len(r->queued); i++) {
+    char *s=strPipeline(deq_head_ith(r->queued,i));
+    printf("[-]  %-10s%s\n","Queued",s);
+    free(s);
+  }
+  tidy(r,0);
+  unblock(&old);
+}
+
+/**
+ * Frees the jobs whose processes have all exited since the last call,
+ * reporting them when the shell has job control.
+ */
+extern void reapJobs(Jobs jobs) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  drain(r);
+  tidy(r,r->tty>=0);
+  admit(r);
+  unblock(&old);
 }
 
-extern void addJobs(Jobs jobs, Pipeline pipeline) {
-  deq_tail_put(jobs,pipeline);
+/**
+ * Starts queued pipelines that now have room, without reporting or
+ * freeing anything, e.g., while the shell waits for input.
+ */
+extern void pollJobs(Jobs jobs) {
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  drain(r);
+  admit(r);
+  unblock(&old);
 }
 
 extern int sizeJobs(Jobs jobs) {
-  return deq_len(jobs);
+  reapJobs(jobs);
+  return deq_len(((JobsRep)jobs)->jobs);
 }
 
+/**
+ * Frees the table. Pipelines still queued are started first, as room
+ * is made for them; the jobs themselves are left running.
+ */
 extern void freeJobs(Jobs jobs) {
-  deq_del(jobs,freePipeline);
+  JobsRep r=(JobsRep)jobs;
+  sigset_t old;
+  block(&old);
+  for (drain(r), admit(r); deq_len(r->queued); drain(r), admit(r))
+    sigsuspend(&old);
+  deq_del(r->queued,0);
+  deq_del(r->jobs,freeJob);
+  deq_del(r->exited,freeJob);
+  free(r->table);
+  free(r->last);
+  free(r);
+  unblock(&old);
 }
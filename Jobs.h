@@ -3,10 +3,31 @@
 
 typedef void *Jobs;
 
+#include <sys/types.h>
+#include <sys/resource.h>
 #include "Pipeline.h"
 
 extern Jobs newJobs();
-extern void addJobs(Jobs jobs, Pipeline pipeline);
+extern void controlJobs(Jobs jobs, int tty);
+extern int ttyJobs(Jobs jobs);
+extern int interruptJobs(Jobs jobs);
+extern int addJobs(Jobs jobs, Pipeline pipeline, pid_t *pids, int n,
+		   pid_t pgid);
+extern int queueJobs(Jobs jobs, Pipeline pipeline);
+extern void limitJobs(Jobs jobs, int max, double load);
+extern int maxJobs(Jobs jobs, double *load);
+extern int findJobs(Jobs jobs, char *spec);
+extern int waitJobs(Jobs jobs, int job);
+extern int waitallJobs(Jobs jobs);
+extern int waitanyJobs(Jobs jobs);
+extern int liveJobs(Jobs jobs, int *ids, int n);
+extern int waitfirstJobs(Jobs jobs, int *ids, int n, int *status);
+extern int fgJobs(Jobs jobs, int job, int echo);
+extern int *statusJobs(Jobs jobs, int *n, struct rusage *ru);
+extern int bgJobs(Jobs jobs, int job);
+extern void printJobs(Jobs jobs, int pids);
+extern void reapJobs(Jobs jobs);
+extern void pollJobs(Jobs jobs);
 extern int sizeJobs(Jobs jobs);
 extern void freeJobs(Jobs jobs);
 
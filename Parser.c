@@ -7,57 +7,141 @@
  *   many of the helper methods to scan through each token and store in a T_words object
  *   while appropriately identifying operators such as '>' '<' '&' ';'. Within a sequence
  *   object, the operator is stored using ->op which is referenced inside the Interpreter. 
+ *   Items joined by && or || are run, or skipped, by the status of the
+ *   one before; a line that ends just after either is continued.
+ *   An item of a sequence may instead be an if, while, or for, whose
+ *   parts are sequences in turn. When a line ends inside one, the
+ *   parse fails quietly, and moreTree() says to add the next line.
  * 
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <setjmp.h>
 
 #include "Parser.h"
 #include "Tree.h"
 #include "Scanner.h"
+#include "Stats.h"
 #include "error.h"
 
 static Scanner scan;
+static jmp_buf fail;		// a syntax error abandons the line, not the shell
+static int depth;		// if, while, and for not yet closed
+static int more;		// the line ended inside one
 
 #undef ERROR
-#define ERROR(s) ERRORLOC(__FILE__,__LINE__,"error","%s (pos: %d)",s,posScanner(scan))
+#define ERROR(s) do { \
+  if (!(more=depth && currScanner(scan)==ScanEnd)) \
+    WARNLOC(__FILE__,__LINE__,"error","%s (pos: %d)",s,posScanner(scan)); \
+  longjmp(fail,1); \
+} while (0)
 
-static char *next()       { return nextScanner(scan); }
-static char *curr()       { return currScanner(scan); }
-static int   cmp(char *s) { return cmpScanner(scan,s); }
+static ScanKind curr() {
+  ScanKind kind=currScanner(scan);
+  if (kind==ScanError)
+    ERROR("unterminated quote or escape");
+  return kind;
+}
+
+static void  next()       { nextScanner(scan); curr(); }
 static int   eat(char *s) { return eatScanner(scan,s); }
 
+// whether the next token is a reserved word, which must be unquoted
+static int is(char *s) {
+  int len;
+  if (curr()!=ScanWord)
+    return 0;
+  char *t=textScanner(scan,&len);
+  return len==strlen(s) && !memcmp(t,s,len);
+}
+
+// eats a reserved word
+static int reserved(char *s) {
+  if (!is(s))
+    return 0;
+  next();
+  return 1;
+}
+
+static void expect(char *s) {
+  static char msg[32];
+  if (reserved(s))
+    return;
+  snprintf(msg,sizeof(msg),"missing %s",s);
+  ERROR(msg);
+}
+
+// whether a reserved word ends the list before it, e.g., "then"
+static int closing() {
+  static char *words[]={"then","elif","else","fi","do","done",0};
+  for (char **w=words; *w; w++)
+    if (is(*w))
+      return 1;
+  return 0;
+}
+
 static T_word p_word();
 static T_words p_words();
+static T_redir p_redir();
 static T_command p_command();
 static T_pipeline p_pipeline();
+static T_control p_control();
 static T_sequence p_sequence();
 
 static T_word p_word() {
-  char *s=curr();
-  if (!s)
+  if (curr()!=ScanWord)
     return 0;
   T_word word=new_word();
-  word->s=strdup(s);
+  word->s=textScanner(scan,&word->len);
   next();
   return word;
 }
 
+/**
+ * Collects the words of a command into one contiguous array, doubling
+ * it in the arena as needed, rather than one list cell per word.
+ */
 static T_words p_words() {
-  //printf("cur: %s\n", curr());
-  T_word word=p_word();
-  if (!word)
-    return 0;
-  T_words words=new_words();
-  words->word=word;
-  if (cmp("|") || cmp("&") || cmp(";"))
-    return words;
-  words->words=p_words();
+  T_words words=0;
+  int max=0;
+  while (curr()==ScanWord) {
+    if (!words)
+      words=new_words();
+    if (words->n==max) {
+      struct T_word *word=words->word;
+      max=max ? 2*max : 8;
+      words->word=new_mem(sizeof(*word)*max);
+      memcpy(words->word,word,sizeof(*word)*words->n);
+    }
+    T_word word=words->word+words->n++;
+    word->s=textScanner(scan,&word->len);
+    next();
+  }
   return words;
 }
 
+/**
+ * Parses the optional "< word" and "> word" after a command's words,
+ * in either order.
+ */
+static T_redir p_redir() {
+  T_redir redir=0;
+  for (;;) {
+    int in=eat("<");
+    if (!in && !eat(">"))
+      return redir;
+    if (!redir)
+      redir=new_redir();
+    T_word *file=in ? &redir->in : &redir->out;
+    if (*file)
+      ERROR("duplicate redirection");
+    if (!(*file=p_word()))
+      ERROR("missing file name for redirection");
+  }
+}
+
 static T_command p_command() {
   T_words words=0;
   words=p_words();
@@ -65,6 +149,7 @@ static T_command p_command() {
     return 0;
   T_command command=new_command();
   command->words=words;
+  command->redir=p_redir();
   return command;
 }
 
@@ -81,35 +166,139 @@ static T_pipeline p_pipeline() {
   pipeline->command=command;
   if (eat("|"))
     pipeline->pipeline=p_pipeline();
-  if (eat(">")){
-    // TODO
-  }
-  if (eat("<")){
-    // TODO
-  }
 
   return pipeline;
 }
 
+/**
+ * Parses the list inside a compound command, up to a reserved word
+ * that closes it. Empty items are allowed, as a line that continues
+ * one is joined to it with "; ".
+ */
+static T_sequence p_list() {
+  while (eat(";"))
+    ;
+  return p_sequence();
+}
+
+// after "if" or "elif": the rest, up to and including "fi"
+static T_control p_if() {
+  T_control control=new_control();
+  control->kind="if";
+  if (!(control->cond=p_list()))
+    ERROR("missing condition");
+  expect("then");
+  control->body=p_list();
+  if (reserved("elif"))
+    control->elif=p_if();
+  else {
+    if (reserved("else"))
+      control->otherwise=p_list();
+    expect("fi");
+  }
+  return control;
+}
+
+// after "while"
+static T_control p_while() {
+  T_control control=new_control();
+  control->kind="while";
+  if (!(control->cond=p_list()))
+    ERROR("missing condition");
+  expect("do");
+  control->body=p_list();
+  expect("done");
+  return control;
+}
+
+// after "for": name [in words]; do list done
+static T_control p_for() {
+  T_control control=new_control();
+  control->kind="for";
+  if (!(control->name=p_word()))
+    ERROR("missing name after for");
+  char *s=control->name->s;
+  for (int i=0; i<control->name->len; i++)
+    if (!(s[i]=='_' || (s[i]>='a' && s[i]<='z') || (s[i]>='A' && s[i]<='Z') ||
+	  (i && s[i]>='0' && s[i]<='9')))
+      ERROR("bad name after for");
+  if (reserved("in"))
+    control->words=p_words();
+  while (eat(";"))
+    ;
+  expect("do");
+  control->body=p_list();
+  expect("done");
+  return control;
+}
+
+/**
+ * Parses an if, while, or for, if one starts here, else returns 0.
+ */
+static T_control p_control() {
+  T_control control=0;
+  depth++;
+  if (reserved("if"))
+    control=p_if();
+  else if (reserved("while"))
+    control=p_while();
+  else if (reserved("for"))
+    control=p_for();
+  depth--;
+  return control;
+}
+
 /**
  * Creates a pipeline object by calling p_pipeline()
  * Creates a new sequence object calling new_sequence()
  * 
  * Eats '&' and ';', and expects another p_sequence()
+ * Eats "&&" and "||", and requires another p_sequence()
+ * A pipeline may be preceded by "time". An item may instead be an if,
+ * while, or for, which cannot run in the background. A sequence ends
+ * at a reserved word that closes a compound command.
  */
 static T_sequence p_sequence() {
-  T_pipeline pipeline=p_pipeline();
-  if (!pipeline)
+  if (closing())
     return 0;
+  int timed=reserved("time");
+  T_control control=timed ? 0 : p_control();
+  T_pipeline pipeline=control ? 0 : p_pipeline();
+  if (!pipeline && !control) {
+    if (timed)
+      ERROR("missing command after time");
+    return 0;
+  }
   T_sequence sequence=new_sequence();
   sequence->pipeline=pipeline;
+  sequence->control=control;
+  sequence->timed=timed;
   // printf("%s", curr()); // Prints & or last character of line not already processed
+  char *op=eat("&&") ? "&&" : eat("||") ? "||" : 0;
+  if (op) {
+    sequence->op=op;
+    depth++;			// so a line may end here, and be continued
+    while (eat(";"))
+      ;
+    if (curr()==ScanEnd || closing())
+      ERROR(op[0]=='&' ? "missing command after &&"
+			: "missing command after ||");
+    depth--;
+    sequence->sequence=p_sequence();
+    if (sequence->sequence->op && !strcmp(sequence->sequence->op,"&"))
+      ERROR("an && or || list cannot run in the background");
+    return sequence;
+  }
   if (eat("&")) {
+    if (control)
+      ERROR("an if, while, or for cannot run in the background");
     sequence->op="&"; // Stores inside sequence, later referenced in Interpreter.c
     sequence->sequence=p_sequence();
   }
   if (eat(";")) {
     sequence->op=";";
+    while (eat(";"))
+      ;
     sequence->sequence=p_sequence();
   }
   // printf("current %s\n", curr()); 
@@ -120,63 +309,34 @@ static T_sequence p_sequence() {
  * Creates scanner using a pointer (passed as parameter)
  * After p_sequence() is called and executed, if there is
  * any characters left in the line, it will throw an error. 
+ * After an error, the tree is empty.
  * 
- * *s is the line to be parsed
+ * *s is the line to be parsed; the tree points into it
  */
 extern Tree parseTree(char *s) { // Called from shell.c, returns tree
   scan=newScanner(s);
-  Tree tree=p_sequence();
-  if (curr())
-    ERROR("extra characters at end of input");
+  Tree tree=0;
+  depth=more=0;
+  if (!setjmp(fail)) {
+    tree=p_sequence();
+    if (curr()!=ScanEnd)
+      ERROR("extra characters at end of input");
+  } else {
+    tree=0;			// whatever was built is freed by freeTree()
+    STAT(parseerrors,1);
+  }
   freeScanner(scan);
   return tree;
 }
 
-static void f_word(T_word t);
-static void f_words(T_words t);
-static void f_command(T_command t);
-static void f_pipeline(T_pipeline t);
-static void f_sequence(T_sequence t);
-
-static void f_word(T_word t) {
-  if (!t)
-    return;
-  if (t->s)
-    free(t->s);
-  free(t);
-}
-
-static void f_words(T_words t) {
-  if (!t)
-    return;
-  f_word(t->word);
-  f_words(t->words);
-  free(t);
-}
-
-static void f_command(T_command t) {
-  if (!t)
-    return;
-  f_words(t->words);
-  free(t);
-}
-
-static void f_pipeline(T_pipeline t) {
-  if (!t)
-    return;
-  f_command(t->command);
-  f_pipeline(t->pipeline);
-  free(t);
-}
-
-static void f_sequence(T_sequence t) {
-  if (!t)
-    return;
-  f_pipeline(t->pipeline);
-  f_sequence(t->sequence);
-  free(t);
+/**
+ * Returns whether the last line parsed failed only because it ended
+ * inside an if, while, or for, so the next line continues it.
+ */
+extern int moreTree() {
+  return more;
 }
 
 extern void freeTree(Tree t) {
-  f_sequence(t);
+  free_mem();
 }
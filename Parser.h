@@ -4,6 +4,7 @@
 typedef void *Tree;
 
 extern Tree parseTree(char *s);
+extern int moreTree();
 extern void freeTree(Tree t);
 
 #endif
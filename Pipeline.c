@@ -1,16 +1,30 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 
 #include "Pipeline.h"
+#include "Vars.h"
+#include "Trace.h"
 #include "deq.h"
 #include "error.h"
 
+// as bash's, with the max RSS of all of the stages added
+#define TIMEFORMAT "\nreal\t%3lR\nuser\t%3lU\nsys\t%3lS\nmaxrss\t%MK"
+
 typedef struct {
   Deq processes;
   int fg;			// not "&"
+  int timed;			// after "time"
+  int *fds;			// pipe ends, while the stages are being started
+  int nfds;
+  int refs;			// holders: a Sequence, a job, or the queue
 } *PipelineRep;
 
 extern Pipeline newPipeline(int fg) {
@@ -19,6 +33,10 @@ extern Pipeline newPipeline(int fg) {
     ERROR("malloc() failed");
   r->processes=deq_new();
   r->fg=fg;
+  r->timed=0;
+  r->fds=0;
+  r->nfds=0;
+  r->refs=1;
   return r;
 }
 
@@ -32,32 +50,242 @@ extern int sizePipeline(Pipeline pipeline) {
   return deq_len(r->processes);
 }
 
-static void execute(Pipeline pipeline, Jobs jobs, int *jobbed, int *eof) {
-  // printf("Execute called\n");
+extern int fgPipeline(Pipeline pipeline) {
+  PipelineRep r=(PipelineRep)pipeline;
+  return r->fg;
+}
+
+// reports the pipeline's times and usage, when it finishes in the foreground
+extern void timePipeline(Pipeline pipeline) {
   PipelineRep r=(PipelineRep)pipeline;
+  r->timed=1;
+}
 
-  for (int i=0; i<sizePipeline(r) && !*eof; i++){
-    if(r->fg == 1){ // TODO CHANGE BACK TO == 1
-      execCommand(deq_head_ith(r->processes,i),pipeline,jobs,jobbed,eof,1); // Processes is a queue, uses head_ith to get i from queue
-    } else {
-      // printf("fg is 0\n");
-      execCommand(deq_head_ith(r->processes,i),pipeline,jobs,jobbed,eof,0); 
+/**
+ * Returns the pipeline as text, for job listings. The caller frees it.
+ */
+extern char *strPipeline(Pipeline pipeline) {
+  PipelineRep r=(PipelineRep)pipeline;
+  char *s=strdup("");
+  for (int i=0; i<sizePipeline(r); i++) {
+    char *c=strCommand(deq_head_ith(r->processes,i));
+    char *t;
+    if (asprintf(&t,"%s%s%s",s,i ? " | " : "",c)==-1)
+      ERROR("asprintf() failed");
+    free(s);
+    free(c);
+    s=t;
+  }
+  return s;
+}
+
+/**
+ * Closes every pipe end of the pipeline. The parent does this once all
+ * stages are started; a forked builtin does it after wiring its own ends,
+ * so that the readers downstream of it can see end-of-file.
+ */
+extern void closePipeline(Pipeline pipeline) {
+  PipelineRep r=(PipelineRep)pipeline;
+  for (int i=0; i<r->nfds; i++)
+    close(r->fds[i]);
+  r->nfds=0;
+}
+
+// seconds to p places, or, with l, as minutes and seconds
+static void seconds(double t, int p, int l) {
+  if (l)
+    fprintf(stderr,"%dm%.*fs",(int)t/60,p,t-60*((int)t/60));
+  else
+    fprintf(stderr,"%.*f",p,t);
+}
+
+/**
+ * Writes a timed pipeline's report to stderr, as TIMEFORMAT (if set)
+ * says, as in bash: %[p][l]R, %[p][l]U and %[p][l]S are the real, user,
+ * and system seconds, to p places, and with l as minutes and seconds;
+ * %P is user plus system as a percentage of real; and %% is a %. %M is
+ * the max RSS, in KB, of the stages added together.
+ */
+static void timing(struct timespec *start, struct rusage *ru) {
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC,&end);
+  double real=end.tv_sec-start->tv_sec+(end.tv_nsec-start->tv_nsec)/1e9;
+  double user=ru->ru_utime.tv_sec+ru->ru_utime.tv_usec/1e6;
+  double sys=ru->ru_stime.tv_sec+ru->ru_stime.tv_usec/1e6;
+  char *fmt=getenv("TIMEFORMAT");
+  if (!fmt)
+    fmt=TIMEFORMAT;
+  if (!*fmt)
+    return;
+  fflush(stdout);
+  for (char *s=fmt; *s; s++) {
+    if (*s!='%' || !s[1]) {
+      putc(*s,stderr);
+      continue;
+    }
+    int p=3, l=0;
+    if (isdigit((unsigned char)s[1]) && (p=*++s-'0')>3)
+      p=3;
+    if (s[1]=='l' && ++s)
+      l=1;
+    switch (*++s) {
+      case 'R': seconds(real,p,l); break;
+      case 'U': seconds(user,p,l); break;
+      case 'S': seconds(sys,p,l); break;
+      case 'P': fprintf(stderr,"%.*f",p>2 ? 2 : p,
+			real>0 ? 100*(user+sys)/real : 0); break;
+      case 'M': fprintf(stderr,"%ld",ru->ru_maxrss); break;
+      case '%': putc('%',stderr); break;
+      default:			// not a conversion: as it is
+	putc('%',stderr);
+	putc(*s,stderr);
     }
-    
   }
+  putc('\n',stderr);
 }
 
-extern void execPipeline(Pipeline pipeline, Jobs jobs, int *eof) {
-  // printf("ExecPipeline called\n");
-  int jobbed=0;
+/**
+ * Sets $? and PIPESTATUS for a finished foreground pipeline: pid[i] is
+ * what starting stage i returned, and a started stage's status is from
+ * the job. A builtin that ran in the shell has its own status, and a
+ * command that could not be started has 127.
+ */
+static void statuses(Jobs jobs, pid_t *pid, int n) {
+  int ncodes, *codes=statusJobs(jobs,&ncodes,0);
+  int status[n];
+  for (int i=0, j=0; i<n; i++)
+    status[i]=pid[i]>0 ? (j<ncodes ? codes[j++] : 0) :
+      pid[i] ? 127 : statusCommand();
+  statusVars(status,n);
+}
+
+/**
+ * Creates all n-1 pipes up front, then starts every stage, so that the
+ * stages run concurrently: stage i reads the read end of pipe i-1 and
+ * writes the write end of pipe i. The pipes are O_CLOEXEC, so an exec'd
+ * stage keeps only the two ends dup2()ed onto its stdin/stdout. The
+ * started processes become a job, which a foreground pipeline waits
+ * for as a whole. With job control, the first stage starts a process
+ * group that the other stages join. A foreground pipeline's statuses,
+ * and usage if it is timed, are taken from its job when it finishes.
+ * Returns whether a job was made.
+ */
+static int execute(Pipeline pipeline, Jobs jobs, int *eof) {
+  PipelineRep r=(PipelineRep)pipeline;
+  int n=sizePipeline(r);
+  int fds[2*n];
+  pid_t pids[n];
+  pid_t stage[n];		// as from execCommand()
+  int started=0;
+  pid_t pgid=0;
+  pid_t *group=ttyJobs(jobs)>=0 ? &pgid : 0;
+  struct timespec start;
+  if (r->timed)
+    clock_gettime(CLOCK_MONOTONIC,&start);
 
-  execute(pipeline,jobs,&jobbed,eof);
-  if (!jobbed)
+  for (int i=0; i<n-1; i++)
+    if (pipe2(fds+2*i,O_CLOEXEC))
+      ERROR("pipe2() failed");
+  r->fds=fds;
+  r->nfds=2*(n-1);
+
+  memset(stage,0,sizeof(stage));
+  for (int i=0; i<n && !*eof; i++) {
+    int in=i ? fds[2*(i-1)] : STDIN_FILENO;
+    int out=i<n-1 ? fds[2*i+1] : STDOUT_FILENO;
+    // a lone foreground builtin may run in the shell itself
+    stage[i]=execCommand(deq_head_ith(r->processes,i),pipeline,jobs,
+			 eof,r->fg && n==1,in,out,group);
+    if (stage[i]>0)
+      pids[started++]=stage[i];
+  }
+
+  closePipeline(pipeline);
+  r->fds=0;
+
+  int fg=r->fg;			// the job may free the pipeline
+  int timed=r->timed;
+  if (started) {
+    int job=addJobs(jobs,pipeline,pids,started,pgid);
+    if (fg) {
+      TRACE(TraceBegin,"wait",0,0);
+      fgJobs(jobs,job,0);
+      TRACE(TraceEnd,"wait",0,0);
+    }
+  }
+  if (fg)
+    statuses(jobs,stage,n);
+  if (fg && timed) {
+    struct rusage ru;
+    memset(&ru,0,sizeof(ru));
+    int k;
+    if (started)
+      statusJobs(jobs,&k,&ru);
+    timing(&start,&ru);
+  }
+  return started;
+}
+
+/**
+ * As the shell's last act, replaces the shell with a lone foreground
+ * external command, rather than starting one and waiting for it.
+ * Returns only if that cannot be done.
+ */
+extern void tailPipeline(Pipeline pipeline, Jobs jobs) {
+  PipelineRep r=(PipelineRep)pipeline;
+  if (r->fg && !r->timed && sizePipeline(r)==1 && !sizeJobs(jobs))
+    tailCommand(deq_head_ith(r->processes,0));
+}
+
+/**
+ * Starts a pipeline now, whatever the background job limit.
+ */
+extern void runPipeline(Pipeline pipeline, Jobs jobs, int *eof) {
+  if (!execute(pipeline,jobs,eof))
     freePipeline(pipeline);	// for fg builtins, and such
 }
 
+/**
+ * Returns a copy of a pipeline, with its words expanded now, as its line
+ * runs, rather than when a queued job is started. The pipeline is
+ * released.
+ */
+static Pipeline expanded(Pipeline pipeline) {
+  PipelineRep r=(PipelineRep)pipeline;
+  PipelineRep x=newPipeline(r->fg);
+  x->timed=r->timed;
+  for (int i=0; i<sizePipeline(r); i++)
+    addPipeline(x,expandCommand(deq_head_ith(r->processes,i)));
+  freePipeline(pipeline);
+  return x;
+}
+
+/**
+ * Starts a pipeline, unless it is a background pipeline that Jobs
+ * queues until there is room for it.
+ */
+extern void execPipeline(Pipeline pipeline, Jobs jobs, int *eof) {
+  PipelineRep r=(PipelineRep)pipeline;
+  if (!r->fg) {
+    pipeline=expanded(pipeline);
+    int zero=0;
+    statusVars(&zero,1);	// as for a started background job
+    if (queueJobs(jobs,pipeline))
+      return;
+  }
+  runPipeline(pipeline,jobs,eof);
+}
+
+// another reference, released by freePipeline()
+extern Pipeline holdPipeline(Pipeline pipeline) {
+  ((PipelineRep)pipeline)->refs++;
+  return pipeline;
+}
+
 extern void freePipeline(Pipeline pipeline) {
   PipelineRep r=(PipelineRep)pipeline;
+  if (--r->refs)
+    return;
   deq_del(r->processes,freeCommand);
   free(r);
 }
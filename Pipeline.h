@@ -9,7 +9,14 @@ typedef void *Pipeline;
 extern Pipeline newPipeline(int fg);
 extern void addPipeline(Pipeline pipeline, Command command);
 extern int sizePipeline(Pipeline pipeline);
+extern int fgPipeline(Pipeline pipeline);
+extern void timePipeline(Pipeline pipeline);
+extern char *strPipeline(Pipeline pipeline);
 extern void execPipeline(Pipeline pipeline, Jobs jobs, int *eof);
+extern void tailPipeline(Pipeline pipeline, Jobs jobs);
+extern void runPipeline(Pipeline pipeline, Jobs jobs, int *eof);
+extern void closePipeline(Pipeline pipeline);
+extern Pipeline holdPipeline(Pipeline pipeline);
 extern void freePipeline(Pipeline pipeline);
 
 #endif
@@ -1,88 +1,155 @@
+/* 
+ * Description: 
+ *   The scanner splits a line into tokens in a single pass, driven by a
+ *   table: each byte is mapped to a class, and each (state, class) pair
+ *   to the next state. A token is only an offset, length, and kind into
+ *   the caller's line; nothing is copied. Operators (| & ; < > && ||)
+ *   need no surrounding whitespace, and a word may contain '...' and "..."
+ *   quoting and backslash escapes. The quoting stays in the token's
+ *   text, and unquoteScanner() removes it once the word's text is needed;
+ *   expandScanner() also substitutes $ variables, when a word has one.
+ *   Where the CPU allows, runs of word bytes and of whitespace are
+ *   skipped with the vector classifier in Delim.c.
+ * 
+ */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "Scanner.h"
+#include "Delim.h"
 #include "error.h"
 
 typedef struct {
-  int eos;
-  char *str;
-  char *pos;
-  char *curr;
+  char *str;			// the caller's line
+  char *pos;			// where the next token starts
+  ScanKind kind;		// current token
+  int off;
+  int len;
+  int scanned;			// current token is valid
+  char *base;			// 64-byte window classified by delimMask
+  uint64_t special;
+  uint64_t spaces;
 } *ScannerRep;
 
+// byte classes; C_Char is 0, so it is the default below
+enum {C_Char,C_End,C_Space,C_Op,C_SQ,C_DQ,C_BS,Classes};
+
+// states; the last three are final
+enum {S_Start,S_Word,S_SQ,S_DQ,S_WBS,S_DBS,S_Done,S_Op,S_Err,States};
+
+static const unsigned char class[256]={
+  [0]=C_End,
+  [' ']=C_Space, ['\t']=C_Space, ['\n']=C_Space, ['\r']=C_Space,
+  ['|']=C_Op, ['&']=C_Op, [';']=C_Op, ['<']=C_Op, ['>']=C_Op,
+  ['\'']=C_SQ, ['"']=C_DQ, ['\\']=C_BS,
+};
+
+static const unsigned char delta[States][Classes]={
+  //          Char    End     Space    Op      SQ      DQ      BS
+  [S_Start]={S_Word, S_Done, S_Start, S_Op,   S_SQ,   S_DQ,   S_WBS},
+  [S_Word] ={S_Word, S_Done, S_Done,  S_Done, S_SQ,   S_DQ,   S_WBS},
+  [S_SQ]   ={S_SQ,   S_Err,  S_SQ,    S_SQ,   S_Word, S_SQ,   S_SQ},
+  [S_DQ]   ={S_DQ,   S_Err,  S_DQ,    S_DQ,   S_DQ,   S_Word, S_DBS},
+  [S_WBS]  ={S_Word, S_Err,  S_Word,  S_Word, S_Word, S_Word, S_Word},
+  [S_DBS]  ={S_DQ,   S_Err,  S_DQ,    S_DQ,   S_DQ,   S_DQ,   S_DQ},
+};
+
 extern Scanner newScanner(char *s) {
   ScannerRep r=(ScannerRep)malloc(sizeof(*r));
   if (!r)
     ERROR("malloc() failed");
-  r->eos=0;
-  r->str=strdup(s);
-  r->pos=r->str;
-  r->curr=0;
+  r->str=s;
+  r->pos=s;
+  r->scanned=0;
+  r->base=0;
   return r;
 }
 
 extern void freeScanner(Scanner scan) {
-  ScannerRep r=scan;
-  free(r->str);
-  if (r->curr)
-    free(r->curr);
-  free(r);
+  free(scan);
 }
 
-static char *thru(char *p, char *q) {
-  for (; *p && strchr(q,*p); p++);
-  return p;
+/**
+ * Returns the first byte at or after p that ends a run of plain word
+ * bytes, or of whitespace. Whole 64-byte windows are classified at
+ * once, and kept for the tokens that follow in the same window.
+ */
+static char *skip(ScannerRep r, char *p, int spaces) {
+  for (;;) {
+    char *base=(char *)((uintptr_t)p&~(uintptr_t)63);
+    if (base!=r->base) {
+      r->base=base;
+      r->special=delimMask(base,&r->spaces);
+    }
+    uint64_t m=(spaces ? ~r->spaces : r->special)>>(p-base);
+    if (m)
+      return p+__builtin_ctzll(m);
+    p=base+64;
+  }
 }
 
-static char *upto(char *p, char *q) {
-  for (; *p && !strchr(q,*p); p++);
-  return p;
+static void lex(ScannerRep r) {
+  char *start=r->pos;
+  char *p=start;
+  int state=S_Start;
+  int next;
+  for (;;) {
+    next=delta[state][class[(unsigned char)*p]];
+    if (next==S_Done || next==S_Err)
+      break;
+    p++;
+    if (next==S_Op) {
+      if ((*start=='&' || *start=='|') && *p==*start)
+	p++;			// && or ||
+      break;
+    }
+    if (delimMask && next==state && (next==S_Start || next==S_Word))
+      p=skip(r,p,next==S_Start);
+    if (next==S_Start)
+      start=p;
+    state=next;
+  }
+  if (next==S_Err)
+    r->kind=ScanError;		// unterminated quote or escape
+  else if (next==S_Op)
+    r->kind=ScanOp;
+  else
+    r->kind=(state==S_Start) ? ScanEnd : ScanWord;
+  r->off=start-r->str;
+  r->len=p-start;
+  r->pos=p;
+  r->scanned=1;
 }
 
-static char *wsthru(char *p) { return thru(p," \t"); }
-static char *wsupto(char *p) { return upto(p," \t"); }
+extern ScanKind nextScanner(Scanner scan) {
+  ScannerRep r=scan;
+  if (r->scanned && r->kind!=ScanEnd && r->kind!=ScanError)
+    r->scanned=0;
+  return currScanner(scan);
+}
 
-extern char *nextScanner(Scanner scan) {
+extern ScanKind currScanner(Scanner scan) {
   ScannerRep r=scan;
-  if (r->eos)
-    return 0;
-  char *old=wsthru(r->pos);
-  char *new=wsupto(old);
-  int size=new-old;
-  if (size==0) {
-    r->eos=1;
-    return 0;
-  }
-  if (r->curr)
-    free(r->curr);
-  r->curr=(char *)malloc(size+1);
-  if (!r->curr)
-    ERROR("malloc() failed");
-  memmove(r->curr,old,size);
-  (r->curr)[size]=0;
-  r->pos=new;
-  return r->curr;
+  if (!r->scanned)
+    lex(r);
+  return r->kind;
 }
 
-extern char *currScanner(Scanner scan) {
+extern char *textScanner(Scanner scan, int *len) {
   ScannerRep r=scan;
-  if (r->eos)
-    return 0;
-  if (r->curr)
-    return r->curr;
-  return nextScanner(scan);
+  currScanner(scan);
+  *len=r->len;
+  return r->str+r->off;
 }
 
 extern int cmpScanner(Scanner scan, char *s) {
   ScannerRep r=scan;
-  currScanner(scan);
-  if (r->eos)
+  if (currScanner(scan)!=ScanOp)
     return 0;
-  if (strcmp(s,r->curr))
-    return 0;
-  return 1;
+  return strlen(s)==r->len && !memcmp(s,r->str+r->off,r->len);
 }
 
 extern int eatScanner(Scanner scan, char *s) {
@@ -96,3 +163,119 @@ extern int posScanner(Scanner scan) {
   ScannerRep r=scan;
   return (r->pos)-(r->str);
 }
+
+/**
+ * Copies a word token's text to d, with its quoting removed, and a
+ * terminator. That takes at most len+1 bytes. Inside "...", a backslash
+ * only escapes " \ and $. Returns the byte after the terminator.
+ */
+extern char *unquoteScanner(char *d, char *s, int len) {
+  char *end=s+len;
+  char quote=0;
+  while (s<end) {
+    char c=*s++;
+    if (quote=='\'') {
+      if (c=='\'')
+	quote=0;
+      else
+	*d++=c;
+    } else if (c=='\\') {
+      if (quote=='"' && !strchr("\"\\$",*s))
+	*d++=c;
+      *d++=*s++;
+    } else if (c==quote)
+      quote=0;
+    else if (!quote && (c=='\'' || c=='"'))
+      quote=c;
+    else
+      *d++=c;
+  }
+  *d++=0;
+  return d;
+}
+
+/**
+ * Returns whether a word token's text has a $ to expand, i.e., one not
+ * inside '...' and not escaped.
+ */
+extern int dollarScanner(char *s, int len) {
+  char *end=s+len;
+  char quote=0;
+  for (; s<end; s++)
+    if (quote=='\'')
+      quote=*s=='\'' ? 0 : quote;
+    else if (*s=='\\')
+      s++;
+    else if (*s=='$')
+      return 1;
+    else if (*s==quote)
+      quote=0;
+    else if (!quote && (*s=='\'' || *s=='"'))
+      quote=*s;
+  return 0;
+}
+
+// the length of the $ reference at s, or 0, and the name it refers to
+static int reference(char *s, char *end, char **name, int *len) {
+  if (s<end && (*s=='?' || *s=='$')) {
+    *name=s;
+    *len=1;
+    return 1;
+  }
+  if (s<end && *s=='{') {
+    char *close=memchr(s,'}',end-s);
+    if (!close || close==s+1)
+      return 0;
+    *name=s+1;
+    *len=close-s-1;
+    return close+1-s;
+  }
+  char *p=s;
+  if (p<end && (*p=='_' || isalpha((unsigned char)*p)))
+    while (p<end && (*p=='_' || isalnum((unsigned char)*p)))
+      p++;
+  *name=s;
+  *len=p-s;
+  return p-s;
+}
+
+/**
+ * Like unquoteScanner(), but also replaces each $NAME, ${NAME}, $? and
+ * $$ outside '...' with its value from lookup. The value is not split
+ * into words. Returns a string for the caller to free.
+ */
+extern char *expandScanner(char *s, int len, ScanLookup lookup) {
+  char *d;
+  size_t size;
+  FILE *f=open_memstream(&d,&size);
+  if (!f)
+    ERROR("open_memstream() failed");
+  char *end=s+len;
+  char quote=0;
+  while (s<end) {
+    char c=*s++;
+    char *name;
+    int n, m;
+    if (quote=='\'') {
+      if (c=='\'')
+	quote=0;
+      else
+	putc(c,f);
+    } else if (c=='\\') {
+      if (quote=='"' && !strchr("\"\\$",*s))
+	putc(c,f);
+      if (s<end)
+	putc(*s++,f);
+    } else if (c=='$' && (n=reference(s,end,&name,&m))) {
+      fputs(lookup(name,m),f);
+      s+=n;
+    } else if (c==quote)
+      quote=0;
+    else if (!quote && (c=='\'' || c=='"'))
+      quote=c;
+    else
+      putc(c,f);
+  }
+  fclose(f);
+  return d;
+}
@@ -3,13 +3,24 @@
 
 typedef void *Scanner;
 
+// kinds of token
+typedef enum {ScanEnd,ScanWord,ScanOp,ScanError} ScanKind;
+
 extern Scanner newScanner(char *s);
 extern void freeScanner(Scanner scan);
 
-extern char *nextScanner(Scanner scan);
-extern char *currScanner(Scanner scan);
+extern ScanKind nextScanner(Scanner scan);
+extern ScanKind currScanner(Scanner scan);
+extern char *textScanner(Scanner scan, int *len);
 extern int cmpScanner(Scanner scan, char *s);
 extern int eatScanner(Scanner scan, char *s);
 extern int posScanner(Scanner scan);
 
+extern char *unquoteScanner(char *d, char *s, int len);
+
+typedef char *(*ScanLookup)(char *name, int len);
+
+extern int dollarScanner(char *s, int len);
+extern char *expandScanner(char *s, int len, ScanLookup lookup);
+
 #endif
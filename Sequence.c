@@ -1,27 +1,110 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "Sequence.h"
+#include "Control.h"
+#include "Vars.h"
 #include "deq.h"
 #include "error.h"
 
-extern Sequence newSequence() { // Sequence is another queue of Sequences
+typedef struct {
+  Deq steps;			// Step
+  int refs;			// holders: the shell running it, the parse cache
+} *SequenceRep;
+
+typedef struct {
+  Pipeline pipeline;		// or
+  Control control;
+  char op;			// '&' for &&, '|' for ||, else 0
+} *Step;
+
+extern Sequence newSequence() { // Sequence is a queue of Pipelines
   // printf("NewSequence called\n");
-  return deq_new();
+  SequenceRep r=(SequenceRep)malloc(sizeof(*r));
+  if (!r)
+    ERROR("malloc() failed");
+  r->steps=deq_new();
+  r->refs=1;
+  return r;
+}
+
+static void add(Sequence sequence, Pipeline pipeline, Control control) {
+  Step step=(Step)malloc(sizeof(*step));
+  if (!step)
+    ERROR("malloc() failed");
+  step->pipeline=pipeline;
+  step->control=control;
+  step->op=0;
+  deq_tail_put(((SequenceRep)sequence)->steps,step);
 }
 
 extern void addSequence(Sequence sequence, Pipeline pipeline) {
   // printf("AddSequence called\n");
-  deq_tail_put(sequence,pipeline);
+  add(sequence,pipeline,0);
+}
+
+// adds an if, while, or for, which the sequence then owns
+extern void controlSequence(Sequence sequence, Control control) {
+  add(sequence,0,control);
+}
+
+// how the last step added leads to the next: by "&&", "||", or neither
+extern void opSequence(Sequence sequence, char *op) {
+  SequenceRep r=(SequenceRep)sequence;
+  Step step=deq_tail_ith(r->steps,0);
+  step->op=op && (!strcmp(op,"&&") || !strcmp(op,"||")) ? op[0] : 0;
+}
+
+// another reference, released by freeSequence()
+extern Sequence holdSequence(Sequence sequence) {
+  ((SequenceRep)sequence)->refs++;
+  return sequence;
+}
+
+static void freeStep(Data d) {
+  Step step=d;
+  if (step->pipeline)
+    freePipeline(step->pipeline);
+  else
+    freeControl(step->control);
+  free(step);
 }
 
 extern void freeSequence(Sequence sequence) {
   // printf("FreeSequence called\n");
-  deq_del(sequence,freePipeline);
+  SequenceRep r=(SequenceRep)sequence;
+  if (--r->refs)
+    return;
+  deq_del(r->steps,freeStep);
+  free(r);
 }
 
-extern void execSequence(Sequence sequence, Jobs jobs, int *eof) {
+/**
+ * Runs each pipeline, or compound command, in turn. One after && is
+ * skipped unless the last status was 0, and one after || unless it was
+ * not; a skipped one leaves the status as is, for its own && or ||.
+ * The sequence is left as it was, so it can be run again; each pipeline
+ * run is held by whoever finishes with it. With tail set, the shell has
+ * nothing left to do after the last one, which may then replace the
+ * shell.
+ */
+extern void execSequence(Sequence sequence, Jobs jobs, int *eof, int tail) {
   // printf("ExecSequence called\n");
-  while (deq_len(sequence) && !*eof){ // While length of the sequence queue is not 0 and pointer of EOF is not 0
-    execPipeline(deq_head_get(sequence),jobs,eof); // Gets top item from sequence, passes in Jobs queue, and EOF pointer
+  SequenceRep r=(SequenceRep)sequence;
+  int n=deq_len(r->steps);
+  char op=0;
+  for (int i=0; i<n && !*eof; i++){ // While there are steps left and EOF is 0
+    Step step=deq_head_ith(r->steps,i);
+    int skip=op && (op=='&')==(exitVars()!=0);
+    op=step->op;
+    if (skip)
+      continue;
+    if (step->control) {
+      execControl(step->control,jobs,eof);
+      continue;
+    }
+    if (tail && i==n-1)
+      tailPipeline(step->pipeline,jobs);
+    execPipeline(holdPipeline(step->pipeline),jobs,eof); // passes in Jobs queue, and EOF pointer
   }
-
-  freeSequence(sequence);
 }
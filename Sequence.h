@@ -5,10 +5,14 @@ typedef void *Sequence;
 
 #include "Jobs.h"
 #include "Pipeline.h"
+#include "Control.h"
 
 extern Sequence newSequence();
 extern void addSequence(Sequence sequence, Pipeline pipeline);
+extern void controlSequence(Sequence sequence, Control control);
+extern void opSequence(Sequence sequence, char *op);
+extern Sequence holdSequence(Sequence sequence);
 extern void freeSequence(Sequence sequence);
-extern void execSequence(Sequence sequence, Jobs jobs, int *eof);
+extern void execSequence(Sequence sequence, Jobs jobs, int *eof, int tail);
 
 #endif
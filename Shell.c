@@ -10,9 +10,13 @@
  * 
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
 #include <signal.h>
 #include <termios.h>
 #include <readline/readline.h>
@@ -21,44 +25,145 @@
 #include "Jobs.h"
 #include "Parser.h"
 #include "Interpreter.h"
+#include "Hash.h"
+#include "Cache.h"
+#include "History.h"
+#include "Input.h"
+#include "Trace.h"
+#include "Stats.h"
+#include "Vars.h"
 #include "error.h"
 
-int main() {
+static Jobs jobs;
+
+static Input input=0;		// non-interactive: no readline at all
+static char *prompt=0;
+
+// readline calls this while it waits for input
+static int poll() {
+  pollJobs(jobs);
+  if (interruptJobs(jobs)) {	// ^C: drop the line, as sh does
+    rl_replace_line("",0);
+    rl_crlf();
+    rl_on_new_line();
+    rl_redisplay();
+  }
+  return 0;
+}
+
+// the next line, with prompt p if interactive, and then in the history
+static char *get(char *p) {
+  TRACE(TraceBegin,"read",0,0);
+  char *line=input ? readInput(input) : readline(p);
+  TRACE(TraceEnd,"read",0,0);
+  if (!input && line && *line)
+    addHistory(line); // appends it to the history list, and file
+  return line;
+}
+
+// the Sequence for a line, from the cache, or parsed and interpreted
+static Sequence compile(char *line) {
+  Sequence sequence=lookupCache(line);
+  if (sequence) {
+    TRACE(TraceMark,"cached",0,0);
+    return sequence;
+  }
+  TRACE(TraceBegin,"parse",0,0);
+  Tree tree=parseTree(line);
+  TRACE(TraceEnd,"parse",0,0);
+  TRACE(TraceBegin,"interpret",0,0);
+  sequence=interpretTree(tree); // Interpreter
+  freeTree(tree);
+  TRACE(TraceEnd,"interpret",0,0);
+  if (sequence)
+    addCache(line,sequence);
+  return sequence;
+}
+
+/**
+ * shell -> reads commands from stdin; with readline, if it is a terminal
+ * shell script -> reads commands from the script
+ * shell -c commands -> runs the commands, a line at a time
+ *
+ * Without a terminal, a lone external command on the last line is
+ * exec()ed in place of the shell, if no jobs remain. A line that ends
+ * inside an if, while, or for is continued by the next, after "; ".
+ * The shell exits with the last command's status, as $? holds it.
+ */
+int main(int argc, char **argv) {
   int eof=0;
-  Jobs jobs=newJobs();
-  char *prompt=0;
+  jobs=newJobs();
+  openTrace();
+  openStats();
 
-  if (isatty(fileno(stdin))) {
-    using_history();
-    read_history(".history");
+  readHash();
+  if (argc>1 && !strcmp(argv[1],"-c")) {
+    if (argc<3)
+      ERROR("-c: option requires an argument");
+    input=textInput(argv[2]);
+  } else if (argc>1) {
+    int fd=open(argv[1],O_RDONLY|O_CLOEXEC);
+    if (fd==-1)
+      ERROR("%s: %s",argv[1],strerror(errno));
+    input=newInput(fd);
+  } else if (isatty(fileno(stdin))) {
+    controlJobs(jobs,fileno(stdin));
+    rl_event_hook=poll;
+    openHistory(".history");
     prompt="$ ";
-  } else {
-    rl_bind_key('\t',rl_insert);
-    rl_outstream=fopen("/dev/null","w");
-  }
+  } else
+    input=newInput(fileno(stdin));
   
   while (!eof) {
-    char *line=readline(prompt);
+    reapJobs(jobs);
+    char *line=get(prompt);
+    interruptJobs(jobs);	// a ^C before the line is not for it
     // printf("%s\n",line); // prints the line as is, ex. pwd would print pwd
     if (!line){
       break;
     }
 
-    if (*line){
-      add_history(line); // adds history to the end of the history list
+    char *joined=0;		// the lines of an if, while, or for
+    Sequence sequence=compile(line);
+    while (!sequence && moreTree()) {
+      if (!joined && !(joined=strdup(line))) // reading on may move line
+	ERROR("strdup() failed");
+      char *rest=get(input ? 0 : "> ");
+      if (!rest) {
+	WARN("unexpected end of input");
+	break;
+      }
+      char *text;
+      if (asprintf(&text,"%s; %s",joined,rest)==-1)
+	ERROR("asprintf() failed");
+      if (!input)
+	free(rest);
+      free(joined);
+      joined=text;
+      sequence=compile(joined);
+    }
+    if (sequence) {
+      TRACE(TraceBegin,"run",0,0);
+      execSequence(sequence,jobs,&eof,input && endInput(input));
+      TRACE(TraceEnd,"run",0,0);
+      freeSequence(sequence);
     }
-    Tree tree=parseTree(line);
-    free(line);
-    interpretTree(tree,&eof,jobs); // Interpreter
-    freeTree(tree);
+    free(joined);
+    if (!input)
+      free(line); // the tree pointed into it
   }
 
-  if (isatty(fileno(stdin))) {
-    write_history(".history");
-    rl_clear_history();
-  } else {
-    fclose(rl_outstream);
+  if (input)
+    freeInput(input);
+  else {
+    closeHistory();
+    writeHash();
   }
+  freeJobs(jobs);
+  closeTrace();
+  closeStats();
   freestateCommand();
-  return 0;
+  freeCache();
+  freeHash();
+  return exitVars();
 }
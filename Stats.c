@@ -0,0 +1,100 @@
+/*
+ * Description:
+ *   Stats publishes the shell's counters in a POSIX shared memory
+ *   segment, named for its pid, so that a monitor can read them without
+ *   sending the shell anything. The segment is made at startup, and
+ *   unlinked when the shell exits, or execs a command in its place.
+ *   With SHELL_STATS=off, or if the segment cannot be made, the counters
+ *   are kept in private memory, for the stats builtin alone. Either way
+ *   stats is never 0, so an update is just an atomic add.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "Stats.h"
+#include "error.h"
+
+static StatsSeg local;
+StatsSeg *stats=&local;
+static char name[64];		// the segment's, while it exists
+static pid_t shell;		// a forked builtin may not unlink it
+
+extern void openStats() {
+  char *s=getenv("SHELL_STATS");
+  shell=getpid();
+  if (!s || strcmp(s,"off")) {
+    snprintf(name,sizeof(name),STATS_PREFIX "%d",shell);
+    int fd=shm_open(name,O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC,0644);
+    void *p=MAP_FAILED;
+    if (fd!=-1 && !ftruncate(fd,sizeof(*stats)))
+      p=mmap(0,sizeof(*stats),PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    if (fd!=-1)
+      close(fd);
+    if (p==MAP_FAILED) {
+      WARN("%s: %s",name,strerror(errno));
+      if (fd!=-1)
+	shm_unlink(name);
+      *name=0;
+    } else {
+      stats=p;
+      atexit(unlinkStats);	// ERROR() exits, too
+    }
+  } else
+    *name=0;
+  stats->pid=shell;
+  stats->started=time(0);
+  stats->version=STATS_VERSION;
+  __atomic_store_n(&stats->magic,STATS_MAGIC,__ATOMIC_RELEASE);
+}
+
+// a rate, as a percentage, or "-" with nothing to rate
+static void rate(FILE *f, char *what, unsigned long hits,
+		 unsigned long misses) {
+  if (hits+misses)
+    fprintf(f,"%-24s%.1f%%\n",what,100.0*hits/(hits+misses));
+  else
+    fprintf(f,"%-24s-\n",what);
+}
+
+/**
+ * Prints a segment's counters, one per line, then the cache hit rates.
+ */
+extern void printStats(FILE *f, StatsSeg *seg) {
+  StatsSeg s;
+#define STATS_FIELD(name,text) \
+  s.name=__atomic_load_n(&seg->name,__ATOMIC_RELAXED);
+  STATS_FIELDS(STATS_FIELD)
+#undef STATS_FIELD
+  fprintf(f,"%-24s%ld\n","pid",seg->pid);
+  fprintf(f,"%-24s%ld\n","uptime, s",(long)time(0)-seg->started);
+#define STATS_FIELD(name,text) fprintf(f,"%-24s%lu\n",text,s.name);
+  STATS_FIELDS(STATS_FIELD)
+#undef STATS_FIELD
+  rate(f,"parse cache hit rate",s.pcachehits,s.pcachemisses);
+  rate(f,"PATH cache hit rate",s.hashhits,s.hashmisses);
+}
+
+// removes the segment's name; the counters go on, privately
+extern void unlinkStats() {
+  if (*name && getpid()==shell) {
+    shm_unlink(name);
+    *name=0;
+  }
+}
+
+extern void closeStats() {
+  unlinkStats();
+  if (stats!=&local && getpid()==shell) {
+    local=*stats;
+    munmap(stats,sizeof(*stats));
+    stats=&local;
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Counters describing a running shell, in a shared memory segment,
+// /dev/shm/shell-stats.PID, for Tools/shstat (or anything) to read while
+// the shell runs. They are updated with relaxed atomics, and may be read
+// at any time; each is consistent on its own, but not with the others.
+
+#include <stdio.h>
+
+#define STATS_MAGIC 0x54534853	// "SHST"
+#define STATS_VERSION 1
+#define STATS_PREFIX "/shell-stats."
+
+// name, and what stats prints for it
+#define STATS_FIELDS(X)						\
+  X(commands,"commands executed")				\
+  X(builtins,"builtins run")					\
+  X(spawns,"processes spawned")					\
+  X(forks,"processes forked")					\
+  X(execfails,"commands not started")				\
+  X(parseerrors,"parse errors")					\
+  X(jobs,"jobs running")					\
+  X(queued,"jobs queued")					\
+  X(reaped,"processes reaped")					\
+  X(utime,"child user time, us")				\
+  X(stime,"child system time, us")				\
+  X(pcachehits,"parse cache hits")				\
+  X(pcachemisses,"parse cache misses")				\
+  X(hashhits,"PATH cache hits")					\
+  X(hashmisses,"PATH cache misses")				\
+  X(history,"history entries")
+
+typedef struct {
+  unsigned magic;
+  unsigned version;
+  long pid;
+  long started;			// time(), at startup
+#define STATS_FIELD(name,text) unsigned long name;
+  STATS_FIELDS(STATS_FIELD)
+#undef STATS_FIELD
+} StatsSeg;
+
+extern StatsSeg *stats;		// never 0
+
+#define STAT(name,n) __atomic_fetch_add(&stats->name,(n),__ATOMIC_RELAXED)
+#define STATSET(name,v) __atomic_store_n(&stats->name,(v),__ATOMIC_RELAXED)
+
+extern void openStats();
+extern void printStats(FILE *f, StatsSeg *seg);
+extern void unlinkStats();
+extern void closeStats();
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Description:
+ *   shstat prints the counters of running shells, from their shared
+ *   memory segments, without disturbing them: those of the shells whose
+ *   pids are given, or else of every shell that has a segment. A
+ *   segment left by a shell that did not exit cleanly is marked so.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../Stats.h"
+
+// prints one segment; returns 0 on success
+static int show(char *name) {
+  int fd=shm_open(name,O_RDONLY,0);
+  struct stat st;
+  if (fd==-1 || fstat(fd,&st) || st.st_size<sizeof(StatsSeg)) {
+    fprintf(stderr,"shstat: %s: %s\n",name,
+	    fd==-1 ? strerror(errno) : "not a shell's");
+    if (fd!=-1)
+      close(fd);
+    return 1;
+  }
+  StatsSeg *seg=mmap(0,sizeof(*seg),PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if (seg==MAP_FAILED) {
+    fprintf(stderr,"shstat: %s: %s\n",name,strerror(errno));
+    return 1;
+  }
+  int ok=__atomic_load_n(&seg->magic,__ATOMIC_ACQUIRE)==STATS_MAGIC &&
+    seg->version==STATS_VERSION;
+  if (!ok)
+    fprintf(stderr,"shstat: %s: not a shell's, or another version\n",name);
+  else {
+    if (kill(seg->pid,0) && errno==ESRCH)
+      printf("(shell %ld is gone)\n",seg->pid);
+    printStats(stdout,seg);
+  }
+  munmap(seg,sizeof(*seg));
+  return !ok;
+}
+
+int main(int argc, char **argv) {
+  char name[NAME_MAX+2];
+  int err=0, shown=0;
+  for (int i=1; i<argc; i++) {
+    snprintf(name,sizeof(name),STATS_PREFIX "%s",argv[i]);
+    if (shown++)
+      printf("\n");
+    err|=show(name);
+  }
+  if (argc>1)
+    return err;
+
+  DIR *dir=opendir("/dev/shm");
+  if (!dir) {
+    perror("shstat: /dev/shm");
+    return 1;
+  }
+  for (struct dirent *d; (d=readdir(dir)); )
+    if (!strncmp(d->d_name,STATS_PREFIX+1,strlen(STATS_PREFIX)-1)) {
+      snprintf(name,sizeof(name),"/%s",d->d_name);
+      if (shown++)
+	printf("\n");
+      err|=show(name);
+    }
+  closedir(dir);
+  return err;
+}
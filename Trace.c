@@ -0,0 +1,145 @@
+/*
+ * Description:
+ *   Trace records what the shell is doing, and when: the phases of each
+ *   line (read, parse, interpret, run), each spawn and foreground wait,
+ *   and each child's start and exit. An event is a CLOCK_MONOTONIC time
+ *   and a few words, put in a fixed ring. A writer claims its slot with
+ *   one atomic add, so the SIGCHLD handler may add an event while the
+ *   shell is adding another; nothing is locked or allocated. When the
+ *   ring is full, the oldest events are overwritten.
+ *
+ *   The events are written as a whole, over the SHELL_TRACE file, when
+ *   the shell exits, or execs a command in its place. A child's start
+ *   and exit are an async slice, on a track for its pid.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+#include "Trace.h"
+#include "error.h"
+
+#define RING (1<<16)		// events kept, a power of two
+#define NAME 16			// bytes of a name kept
+
+typedef struct {
+  long ns;
+  char kind;
+  char name[NAME];
+  int pid;
+  int status;
+} Event;
+
+int traceOn=0;
+
+static Event *ring=0;
+static unsigned long head=0;	// events ever added
+static int fd=-1;
+static pid_t shell;		// children's copies do not write
+
+extern void openTrace() {
+  char *file=getenv("SHELL_TRACE");
+  if (!file || !*file)
+    return;
+  fd=open(file,O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+  if (fd==-1) {
+    WARN("%s: %s",file,strerror(errno));
+    return;
+  }
+  if (!(ring=calloc(RING,sizeof(*ring))))
+    ERROR("calloc() failed");
+  shell=getpid();
+  traceOn=1;
+  atexit(closeTrace);		// ERROR() exits, too
+}
+
+/**
+ * Adds an event. This is async-signal-safe: a handler may call it while
+ * the shell is in it.
+ */
+extern void addTrace(char kind, const char *name, int pid, int status) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  Event *e=ring+(__atomic_fetch_add(&head,1,__ATOMIC_RELAXED)&(RING-1));
+  e->ns=t.tv_sec*1000000000L+t.tv_nsec;
+  e->kind=kind;
+  strncpy(e->name,name,NAME-1);
+  e->name[NAME-1]=0;
+  e->pid=pid;
+  e->status=status;
+}
+
+// a name, as a JSON string
+static void string(FILE *f, char *s) {
+  putc('"',f);
+  for (; *s; s++)
+    if (*s=='"' || *s=='\\')
+      fprintf(f,"\\%c",*s);
+    else if ((unsigned char)*s<' ')
+      fprintf(f,"\\u%04x",*s);
+    else
+      putc(*s,f);
+  putc('"',f);
+}
+
+static void event(FILE *f, Event *e) {
+  fprintf(f,"{\"ph\":\"%c\",\"ts\":%ld.%03ld,\"pid\":%d,\"tid\":%d,"
+	  "\"name\":",e->kind,e->ns/1000,e->ns%1000,shell,shell);
+  if (e->kind==TraceStart || e->kind==TraceExit) {
+    fprintf(f,"\"child\",\"cat\":\"child\",\"id\":%d,\"args\":{\"pid\":%d",
+	    e->pid,e->pid);
+    if (e->kind==TraceStart) {
+      fprintf(f,",\"command\":");
+      string(f,e->name);
+    } else
+      fprintf(f,",\"status\":%d",e->status);
+    fprintf(f,"}");
+  } else {
+    string(f,e->name);
+    if (e->kind==TraceMark)
+      fprintf(f,",\"s\":\"t\"");
+  }
+  fprintf(f,"}");
+}
+
+/**
+ * Writes the events in the ring over the trace file, oldest first. A
+ * Begin or End whose partner was overwritten is dropped by the viewer.
+ */
+extern void writeTrace() {
+  if (!ring || getpid()!=shell)
+    return;
+  unsigned long end=__atomic_load_n(&head,__ATOMIC_RELAXED);
+  unsigned long i=end>RING ? end-RING : 0;
+  int dup=fcntl(fd,F_DUPFD_CLOEXEC,0);
+  FILE *f=dup==-1 ? 0 : fdopen(dup,"w");
+  if (!f || ftruncate(fd,0) || lseek(dup,0,SEEK_SET)) {
+    WARN("SHELL_TRACE: cannot write");
+    if (f)
+      fclose(f);
+    return;
+  }
+  fprintf(f,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  for (; i<end; i++) {
+    event(f,ring+(i&(RING-1)));
+    fprintf(f,i+1<end ? ",\n" : "\n");
+  }
+  fprintf(f,"]}\n");
+  fclose(f);
+}
+
+extern void closeTrace() {
+  if (!ring)
+    return;
+  traceOn=0;			// a handler that runs after this adds nothing
+  writeTrace();
+  close(fd);
+  free(ring);
+  ring=0;
+}
@@ -0,0 +1,27 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Timestamped events, kept in memory while SHELL_TRACE names a file,
+// and written there as Chrome trace-event JSON (for chrome://tracing,
+// or Perfetto). With tracing off, TRACE() is a single, predicted branch.
+
+// kinds of event, as Chrome names them
+#define TraceBegin 'B'		// a phase of the shell's work starts,
+#define TraceEnd 'E'		// and ends
+#define TraceStart 'b'		// a child starts,
+#define TraceExit 'e'		// and is reaped
+#define TraceMark 'i'		// something happens
+
+extern int traceOn;
+
+#define TRACE(kind,name,pid,status) do {			\
+  if (__builtin_expect(traceOn,0))				\
+    addTrace(kind,name,pid,status);				\
+} while (0)
+
+extern void openTrace();
+extern void addTrace(char kind, const char *name, int pid, int status);
+extern void writeTrace();
+extern void closeTrace();
+
+#endif
@@ -5,13 +5,70 @@
 #include "Tree.h"
 #include "error.h"
 
+/*
+ * Every tree node and word array is bump-allocated from one
+ * arena, which free_mem() empties in one step once the line is done.
+ * When a line needed more than one block, the blocks are replaced by a
+ * single block of their total size, so a line like the last one needs
+ * no malloc() at all.
+ */
+
+#define BLOCK 4096
+#define ALIGN (sizeof(void *))
+
+typedef struct Block {
+  struct Block *next;
+  size_t size;
+  size_t used;
+  char mem[];
+} *Block;
+
+static Block arena=0;
+
+static Block new_block(size_t size, Block next) {
+  Block b=malloc(sizeof(*b)+size);
+  if (!b) ERROR("malloc() failed");
+  b->next=next;
+  b->size=size;
+  b->used=0;
+  return b;
+}
+
+extern void *new_mem(size_t size) {
+  size=(size+ALIGN-1)&~(ALIGN-1);
+  if (!arena || arena->size-arena->used<size) {
+    size_t n=arena ? 2*arena->size : BLOCK;
+    arena=new_block(n<size ? size : n,arena);
+  }
+  void *v=arena->mem+arena->used;
+  arena->used+=size;
+  return v;
+}
+
+extern void free_mem() {
+  if (!arena)
+    return;
+  if (arena->next) {
+    size_t total=0;
+    for (Block b=arena; b; ) {
+      Block next=b->next;
+      total+=b->size;
+      free(b);
+      b=next;
+    }
+    arena=new_block(total,0);
+  }
+  arena->used=0;
+}
+
 #define ALLOC(t) \
-  t v=malloc(sizeof(*v)); \
-  if (!v) ERROR("malloc() failed"); \
+  t v=new_mem(sizeof(*v)); \
   return memset(v,0,sizeof(*v));
 
 extern T_sequence new_sequence() {ALLOC(T_sequence)}
+extern T_control  new_control()  {ALLOC(T_control)}
 extern T_pipeline new_pipeline() {ALLOC(T_pipeline)}
 extern T_command  new_command()  {ALLOC(T_command)}
+extern T_redir    new_redir()    {ALLOC(T_redir)}
 extern T_words    new_words()    {ALLOC(T_words)}
 extern T_word     new_word()     {ALLOC(T_word)}
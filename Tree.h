@@ -1,18 +1,34 @@
 #ifndef TREE_H
 #define TREE_H
 
+#include <stddef.h>
+
 typedef struct T_sequence *T_sequence;
+typedef struct T_control  *T_control;
 typedef struct T_pipeline *T_pipeline;
 typedef struct T_command  *T_command;
+typedef struct T_redir    *T_redir;
 typedef struct T_words    *T_words;
 typedef struct T_word     *T_word;
 
 struct T_sequence {
   T_pipeline pipeline;
-  char *op;			/* ; or & */
+  T_control control;		/* or an if, while, or for */
+  char *op;			/* ; & && or || */
+  int timed;			/* after "time" */
   T_sequence sequence;
 };
 
+struct T_control {
+  char *kind;			/* "if", "while", or "for" */
+  T_sequence cond;		/* if or while this, */
+  T_sequence body;		/* then or do this */
+  T_control elif;		/* if: the next elif, */
+  T_sequence otherwise;		/* or else this */
+  T_word name;			/* for name */
+  T_words words;		/* in words, or 0 */
+};
+
 struct T_pipeline {
   T_command command;
   T_pipeline pipeline;
@@ -20,21 +36,33 @@ struct T_pipeline {
 
 struct T_command {
   T_words words;
+  T_redir redir;
+};
+
+struct T_redir {
+  T_word in;			/* < word */
+  T_word out;			/* > word */
 };
 
 struct T_words {
-  T_word word;
-  T_words words;
+  int n;
+  struct T_word *word;		/* n words, contiguous */
 };
 
 struct T_word {
-  char *s;
+  char *s;			/* into the line, still quoted, */
+  int len;			/* and not NUL-terminated */
 };
 
 extern T_sequence new_sequence();
+extern T_control  new_control();
 extern T_pipeline new_pipeline();
 extern T_command  new_command();
+extern T_redir    new_redir();
 extern T_words    new_words();
 extern T_word     new_word();
 
+extern void *new_mem(size_t size);
+extern void free_mem();		/* frees every tree at once */
+
 #endif
@@ -0,0 +1,446 @@
+/*
+ * Description:
+ *   Utility implements echo, printf, test (and [) and cat as the shell's
+ *   builtins, as POSIX describes them, with bash's echo options. They
+ *   write through stdout, which the caller flushes; cat copies with
+ *   read() and write(), after flushing it.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#include "Utility.h"
+#include "error.h"
+
+#define BLOCK (1<<16)
+
+/**
+ * Writes the backslash escape at *s, and leaves *s at its last byte. In
+ * a printf format, an octal escape is \nnn; elsewhere it is \0nnn.
+ * Returns 1 for \c, which stops all output.
+ */
+static int escape(char **s, int format) {
+  char *p=*s+1;
+  char *q=strchr("abefnrtv\\",*p);
+  if (*p && q)
+    putchar("\a\b\033\f\n\r\t\v\\"[q-"abefnrtv\\"]);
+  else if (*p=='c')
+    return 1;
+  else if (*p=='0' || (format && *p>='1' && *p<='7')) {
+    int c=0;
+    if (!format)
+      p++;
+    for (int n=0; n<3 && *p>='0' && *p<='7'; n++)
+      c=8*c+*p++-'0';
+    putchar(c);
+    p--;
+  } else {
+    putchar('\\');
+    if (!*p)
+      p--;
+    else
+      putchar(*p);
+  }
+  *s=p;
+  return 0;
+}
+
+// writes s with its backslash escapes done; returns 1 after a \c
+static int escapes(char *s) {
+  for (; *s; s++)
+    if (*s!='\\')
+      putchar(*s);
+    else if (escape(&s,0))
+      return 1;
+  return 0;
+}
+
+/**
+ * echo [-neE] [arg...] -> writes the args, separated by spaces: -n
+ * leaves out the newline, and -e does backslash escapes, as in bash.
+ */
+extern int echoUtility(char **argv) {
+  int nl=1, esc=0;
+  for (argv++; *argv && **argv=='-' && (*argv)[1] &&
+	 strspn(*argv+1,"neE")==strlen(*argv+1); argv++)
+    for (char *s=*argv+1; *s; s++)
+      if (*s=='n')
+	nl=0;
+      else
+	esc=*s=='e';
+  for (char **a=argv; *a; a++) {
+    if (a!=argv)
+      putchar(' ');
+    if (!esc)
+      fputs(*a,stdout);
+    else if (escapes(*a))
+      return 0;
+  }
+  if (nl)
+    putchar('\n');
+  return 0;
+}
+
+// a numeric argument, or a character's value after a quote; warns if bad
+static long long number(char *s, int *status) {
+  if (*s=='\'' || *s=='"')
+    return (unsigned char)s[1];
+  char *end;
+  errno=0;
+  long long n=strtoll(s,&end,0);
+  if (end==s || *end || errno) {
+    WARN("printf: %s: invalid number",s);
+    *status=1;
+  }
+  return n;
+}
+
+/**
+ * printf format [arg...] -> writes the args as format says, reusing it
+ * while args remain. Conversions are those of printf(3) for integers,
+ * floating point, strings and characters, with flags, width and
+ * precision, plus %b, for a string with backslash escapes.
+ */
+extern int printfUtility(char **argv) {
+  char *format=argv[1];
+  if (!format) {
+    WARN("usage: printf format [arg...]");
+    return 2;
+  }
+  char **arg=argv+2;
+  int status=0;
+  do {
+    int used=0;
+    for (char *s=format; *s; s++) {
+      if (*s=='\\') {
+	if (escape(&s,1))
+	  return status;
+	continue;
+      }
+      if (*s!='%') {
+	putchar(*s);
+	continue;
+      }
+      if (s[1]=='%') {
+	putchar(*++s);
+	continue;
+      }
+      // the spec, without a length modifier, to which one is added
+      size_t len=1+strspn(s+1,"-+ #0");
+      len+=strspn(s+len,"0123456789");
+      if (s[len]=='.')
+	len+=1+strspn(s+len+1,"0123456789");
+      char spec[len+4];
+      memcpy(spec,s,len);
+      char conv=s[len];
+      char *a=*arg ? *arg : "";
+      used|=*arg!=0;
+      if (*arg && conv)
+	arg++;
+      switch (conv) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+	  sprintf(spec+len,"ll%c",conv);
+	  break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+	case 's': case 'c': case 'b':
+	  sprintf(spec+len,"%c",strchr("cb",conv) ? 's' : conv);
+	  break;
+	default:
+	  WARN("printf: %%%c: invalid conversion",conv ? conv : ' ');
+	  return 1;
+      }
+      s+=len;
+      if (strchr("diouxX",conv))
+	printf(spec,number(a,&status));
+      else if (strchr("fFeEgG",conv)) {
+	char *end;
+	double d=strtod(a,&end);
+	if (*a && *end) {
+	  WARN("printf: %s: invalid number",a);
+	  status=1;
+	}
+	printf(spec,d);
+      } else if (conv=='c')
+	printf(spec,(char []){*a,0});
+      else if (conv=='s')
+	printf(spec,a);
+      else if (escapes(a))	// %b, without its width
+	return status;
+    }
+    if (!used)
+      break;
+  } while (*arg);
+  return status;
+}
+
+// test's operands and where it is in them; errors longjmp out
+typedef struct {
+  char **arg;
+  int n;
+  int i;
+} Test;
+
+static int expr(Test *t);
+
+static char *peek(Test *t, int k) {
+  return t->i+k<t->n ? t->arg[t->i+k] : 0;
+}
+
+static int binary(char *op) {
+  static char *ops[]={"=","==","!=","<",">","-eq","-ne","-lt","-le","-gt",
+		      "-ge","-nt","-ot","-ef",0};
+  for (char **p=ops; op && *p; p++)
+    if (!strcmp(op,*p))
+      return 1;
+  return 0;
+}
+
+static int unary(char *op) {
+  return op && op[0]=='-' && op[1] && !op[2] &&
+    strchr("bcdefghknprsStuwxzLO",op[1]);
+}
+
+static long long integer(Test *t, char *s) {
+  char *end;
+  errno=0;
+  long long n=strtoll(s,&end,10);
+  while (*end==' ' || *end=='\t')
+    end++;
+  if (end==s || *end || errno) {
+    WARN("test: %s: integer expected",s);
+    t->i=-1;
+  }
+  return n;
+}
+
+static int file(char op, char *s) {
+  struct stat st;
+  if (op=='t') {
+    char *end;
+    long fd=strtol(s,&end,10);
+    return !*end && isatty(fd);
+  }
+  if (op=='L' || op=='h')
+    return !lstat(s,&st) && S_ISLNK(st.st_mode);
+  if (stat(s,&st))
+    return 0;
+  switch (op) {
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 'e': return 1;
+    case 'f': return S_ISREG(st.st_mode);
+    case 'g': return (st.st_mode&S_ISGID)!=0;
+    case 'k': return (st.st_mode&S_ISVTX)!=0;
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 'r': return !access(s,R_OK);
+    case 's': return st.st_size>0;
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 'u': return (st.st_mode&S_ISUID)!=0;
+    case 'w': return !access(s,W_OK);
+    case 'x': return !access(s,X_OK);
+    case 'O': return st.st_uid==geteuid();
+  }
+  return 0;
+}
+
+static int compare(Test *t, char *a, char *op, char *b) {
+  if (!strcmp(op,"=") || !strcmp(op,"=="))
+    return !strcmp(a,b);
+  if (!strcmp(op,"!="))
+    return strcmp(a,b)!=0;
+  if (!strcmp(op,"<"))
+    return strcmp(a,b)<0;
+  if (!strcmp(op,">"))
+    return strcmp(a,b)>0;
+  if (!strcmp(op,"-nt") || !strcmp(op,"-ot") || !strcmp(op,"-ef")) {
+    struct stat x, y;
+    int hx=!stat(a,&x), hy=!stat(b,&y);
+    if (op[1]=='e')
+      return hx && hy && x.st_dev==y.st_dev && x.st_ino==y.st_ino;
+    if (op[1]=='n')
+      return hx && (!hy || x.st_mtim.tv_sec>y.st_mtim.tv_sec ||
+		    (x.st_mtim.tv_sec==y.st_mtim.tv_sec &&
+		     x.st_mtim.tv_nsec>y.st_mtim.tv_nsec));
+    return hy && (!hx || y.st_mtim.tv_sec>x.st_mtim.tv_sec ||
+		  (y.st_mtim.tv_sec==x.st_mtim.tv_sec &&
+		   y.st_mtim.tv_nsec>x.st_mtim.tv_nsec));
+  }
+  long long l=integer(t,a), r=integer(t,b);
+  switch (op[1]*256+op[2]) {
+    case 'e'*256+'q': return l==r;
+    case 'n'*256+'e': return l!=r;
+    case 'l'*256+'t': return l<r;
+    case 'l'*256+'e': return l<=r;
+    case 'g'*256+'t': return l>r;
+  }
+  return l>=r;
+}
+
+// primary: ( expr ), a binary or unary test, or a string
+static int primary(Test *t) {
+  char *a=peek(t,0);
+  if (!a) {
+    WARN("test: argument expected");
+    t->i=-1;
+    return 0;
+  }
+  if (binary(peek(t,1)) && peek(t,2)) {
+    t->i+=3;
+    return compare(t,a,t->arg[t->i-2],t->arg[t->i-1]);
+  }
+  if (unary(a) && peek(t,1)) {
+    char *s=t->arg[++t->i];
+    t->i++;
+    if (a[1]=='n' || a[1]=='z')
+      return !*s==(a[1]=='z');
+    return file(a[1],s);
+  }
+  if (!strcmp(a,"(") && peek(t,1)) {
+    t->i++;
+    int v=expr(t);
+    if (t->i<0 || !peek(t,0) || strcmp(peek(t,0),")")) {
+      if (t->i>=0)
+	WARN("test: ')' expected");
+      t->i=-1;
+      return 0;
+    }
+    t->i++;
+    return v;
+  }
+  t->i++;
+  return *a!=0;
+}
+
+static int not(Test *t) {
+  char *a=peek(t,0);
+  if (a && !strcmp(a,"!") && peek(t,1) &&
+      !(binary(peek(t,1)) && t->i+3==t->n)) { // ! = x compares "!"
+    t->i++;
+    return !not(t);
+  }
+  return primary(t);
+}
+
+static int and(Test *t) {
+  int v=not(t);
+  while (t->i>=0 && peek(t,0) && !strcmp(peek(t,0),"-a")) {
+    t->i++;
+    v&=not(t);
+  }
+  return v;
+}
+
+static int expr(Test *t) {
+  int v=and(t);
+  while (t->i>=0 && peek(t,0) && !strcmp(peek(t,0),"-o")) {
+    t->i++;
+    v|=and(t);
+  }
+  return v;
+}
+
+/**
+ * test expression, or [ expression ] -> 0 if the expression is true, 1
+ * if it is false, and 2 if it is not well formed. Expressions are
+ * POSIX's, with -a, -o, !, and parentheses, and bash's == < and >.
+ */
+extern int testUtility(char **argv) {
+  int n=0;
+  while (argv[n+1])
+    n++;
+  if (!strcmp(argv[0],"[")) {
+    if (!n || strcmp(argv[n],"]")) {
+      WARN("[: missing ']'");
+      return 2;
+    }
+    n--;
+  }
+  if (!n)
+    return 1;
+  Test t={argv+1,n,0};
+  int v=expr(&t);
+  if (t.i>=0 && t.i<n) {
+    WARN("test: %s: unexpected",argv[1+t.i]);
+    return 2;
+  }
+  return t.i<0 ? 2 : !v;
+}
+
+/**
+ * Whether cat here takes these arguments: files, -, and -u. Other
+ * options are left to the real cat.
+ */
+extern int catownsUtility(char **argv) {
+  for (argv++; *argv; argv++)
+    if (**argv=='-' && (*argv)[1] && strcmp(*argv,"-u"))
+      return 0;
+  return 1;
+}
+
+/**
+ * Copies fd to stdout; returns 0, or warns and returns 1. A read
+ * interrupted by a signal the shell catches without SA_RESTART, i.e.,
+ * ^C, returns 128+SIGINT.
+ */
+static int copy(int fd, char *name, char *buf) {
+  for (;;) {
+    ssize_t n=read(fd,buf,BLOCK);
+    if (n==-1 && errno==EINTR)
+      return 128+SIGINT;
+    if (n<0) {
+      WARN("cat: %s: %s",name,strerror(errno));
+      return 1;
+    }
+    if (!n)
+      return 0;
+    for (ssize_t w, done=0; done<n; done+=w)
+      if ((w=write(STDOUT_FILENO,buf+done,n-done))<0) {
+	if (errno==EINTR)
+	  return 128+SIGINT;
+	WARN("cat: write: %s",strerror(errno));
+	return 1;
+      }
+  }
+}
+
+/**
+ * cat [-u] [file...] -> copies each file, or stdin for - or none, to
+ * stdout, unbuffered.
+ */
+extern int catUtility(char **argv) {
+  char *buf=malloc(BLOCK);
+  if (!buf)
+    ERROR("malloc() failed");
+  int status=0;
+  fflush(stdout);
+  int files=0;
+  for (argv++; *argv && status<=1; argv++) { // ^C: stop
+    if (!strcmp(*argv,"-u"))
+      continue;
+    files++;
+    int fd=STDIN_FILENO;
+    if (strcmp(*argv,"-") && (fd=open(*argv,O_RDONLY|O_CLOEXEC))==-1) {
+      WARN("cat: %s: %s",*argv,strerror(errno));
+      status=1;
+      continue;
+    }
+    int s=copy(fd,*argv,buf);
+    status=s>1 ? s : status|s;
+    if (fd!=STDIN_FILENO)
+      close(fd);
+  }
+  if (!files)
+    status=copy(STDIN_FILENO,"-",buf);
+  free(buf);
+  return status;
+}
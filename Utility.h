@@ -0,0 +1,14 @@
+#ifndef UTILITY_H
+#define UTILITY_H
+
+// Small utilities that scripts run constantly, done in the shell, so as
+// not to start a process for each. Each takes a command's argv, writes
+// to stdout (or reads stdin), and returns an exit status.
+
+extern int echoUtility(char **argv);
+extern int printfUtility(char **argv);
+extern int testUtility(char **argv);
+extern int catUtility(char **argv);
+extern int catownsUtility(char **argv);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * Description:
+ *   Vars supplies the values for $NAME and ${NAME}. A name is looked up
+ *   in the shell's variables (a for loop's), then in the environment,
+ *   except for those the shell keeps itself: $? is the exit status of
+ *   the last foreground pipeline, $PIPESTATUS the statuses of each of
+ *   its stages, separated by spaces, and ${PIPESTATUS[i]} that of stage
+ *   i. $$ is the shell's pid.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Vars.h"
+#include "error.h"
+
+#define NAME 256		// longest name looked up
+
+typedef struct {
+  char *name;
+  char *value;
+} Var;
+
+static Var *vars=0;		// the shell's own, which are not exported
+static int nvars=0;
+static int *codes=0;		// PIPESTATUS
+static int ncodes=0;
+static char *value=0;		// what lookupVars() returned last
+static size_t size=0;
+
+/**
+ * Records the exit statuses of the stages of the last foreground
+ * pipeline.
+ */
+extern void statusVars(int *status, int n) {
+  if (!(codes=realloc(codes,sizeof(*codes)*(n ? n : 1))))
+    ERROR("realloc() failed");
+  memcpy(codes,status,sizeof(*codes)*n);
+  ncodes=n;
+}
+
+// $?: the exit status of the last pipeline
+extern int exitVars() {
+  return ncodes ? codes[ncodes-1] : 0;
+}
+
+/**
+ * Sets a shell variable, which hides one in the environment of the same
+ * name, but is not passed to commands.
+ */
+extern void setVars(char *name, char *v) {
+  int i=0;
+  while (i<nvars && strcmp(vars[i].name,name))
+    i++;
+  if (i==nvars) {
+    if (!(vars=realloc(vars,sizeof(*vars)*(nvars+1))) ||
+	!(vars[i].name=strdup(name)))
+      ERROR("malloc() failed");
+    vars[nvars++].value=0;
+  }
+  free(vars[i].value);
+  if (!(vars[i].value=strdup(v)))
+    ERROR("strdup() failed");
+}
+
+// the value of a variable the shell keeps, in value, or 0
+static char *shell(char *name) {
+  int need=ncodes*12+1;
+  if (size<need && !(value=realloc(value,size=need<64 ? 64 : need)))
+    ERROR("realloc() failed");
+  for (int i=0; i<nvars; i++)
+    if (!strcmp(vars[i].name,name))
+      return vars[i].value;
+  if (!strcmp(name,"?"))
+    sprintf(value,"%d",exitVars());
+  else if (!strcmp(name,"$"))
+    sprintf(value,"%d",getpid());
+  else if (!strcmp(name,"PIPESTATUS")) {
+    *value=0;
+    for (int i=0, len=0; i<ncodes; i++)
+      len+=sprintf(value+len,"%s%d",i ? " " : "",codes[i]);
+  } else if (!strncmp(name,"PIPESTATUS[",11)) {
+    char *end;
+    long i=strtol(name+11,&end,10);
+    if (end==name+11 || strcmp(end,"]"))
+      return 0;
+    *value=0;
+    if (0<=i && i<ncodes)
+      sprintf(value,"%d",codes[i]);
+  } else
+    return 0;
+  return value;
+}
+
+/**
+ * Returns the value of the variable named by the len bytes at name, or
+ * "" if it has none. The value may change at the next call.
+ */
+extern char *lookupVars(char *name, int len) {
+  char s[NAME];
+  if (len>=NAME)
+    return "";
+  memcpy(s,name,len);
+  s[len]=0;
+  char *v=shell(s);
+  if (!v)
+    v=getenv(s);
+  return v ? v : "";
+}
@@ -0,0 +1,12 @@
+#ifndef VARS_H
+#define VARS_H
+
+// The values that $ expansion substitutes: the shell's variables (set by
+// for), the environment, and the shell's own $?, $$ and PIPESTATUS.
+
+extern void statusVars(int *status, int n);
+extern int exitVars();
+extern void setVars(char *name, char *value);
+extern char *lookupVars(char *name, int len);
+
+#endif